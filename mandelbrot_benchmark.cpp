@@ -0,0 +1,496 @@
+//
+// Copyright Andrew Cox 2017. All rights reserved.
+//
+// A repeatable benchmark of mandelbrotAsyncTiled: renders each of a set of
+// canonical views at each tile size, iteration limit and worker count in turn,
+// and writes the frame rate, pixel rate, frame latency percentiles, CPU time
+// and scaling with workers of each as JSON, optionally comparing them with a
+// baseline written by an earlier run. Each configuration is timed waiting for
+// its frames on a FrameCompletion latch and by spinning on the tiles' futures,
+// so the CPU time the latch saves can be compared across worker counts.
+//
+
+// Use the example's renderer, leaving out its main():
+#define MANDELBROT_EXAMPLE_NO_MAIN
+#include "mandelbrot_example.cpp"
+
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+    struct BenchmarkView {
+        const char* name;
+        async_tiled::DeepView view;
+    };
+
+    /** The views swept by default, from cheapest per pixel to dearest. */
+    const BenchmarkView BENCHMARK_VIEWS[] = {
+            // Wholly inside the main cardioid, so the interior checks fill every pixel:
+            {"interior", {"-0.1", "0", 0.2}},
+            {"full", {"-0.5", "0", 3.0}},
+            {"seahorse", {"-0.75", "0.1", 0.05}},
+            // On a filament deep enough that floats can't resolve it:
+            {"deep-boundary", {"-0.743643887037151", "0.131825904205330", 1e-5}},
+    };
+
+    /** How the benchmark waits for each frame's tiles. */
+    enum class WaitMode {
+        /** Sleep on a FrameCompletion until the last tile is done. */
+        Latch,
+        /** Poll each tile's future in turn, yielding between polls, as the example's --spin-wait does. */
+        Spin
+    };
+
+    const char* waitModeName(const WaitMode mode)
+    {
+        return mode == WaitMode::Spin ? "spin" : "latch";
+    }
+
+    /** One configuration's measurements. */
+    struct BenchmarkResult {
+        std::string view;
+        unsigned tileDim;
+        unsigned maxIters;
+        unsigned workers;
+        /** A waitModeName(). */
+        std::string wait;
+        unsigned frames;
+        double fps;
+        double pixelsPerSecond;
+        double p50Ms;
+        double p90Ms;
+        double p99Ms;
+        /** The CPU time of the whole process per frame, workers and waiting thread together. */
+        double cpuMsPerFrame;
+        /** CPU time over wall time: how many cores were busy on average while frames rendered. */
+        double cpuCores;
+        /** The speedup over the fewest workers measured, divided by the ratio of workers. 1 is perfect scaling. */
+        double scalingEfficiency;
+    };
+
+    /** The value of fraction of the way through sorted, rounding up to the next sample. */
+    double percentile(const std::vector<double>& sorted, const double fraction)
+    {
+        const size_t rank = size_t(std::ceil(fraction * sorted.size()));
+        return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+    }
+
+    /** Parse a comma separated list of numbers, such as "16,32,64". */
+    bool parseList(const char* text, std::vector<unsigned>& outValues)
+    {
+        outValues.clear();
+        while(*text)
+        {
+            char* end = nullptr;
+            const unsigned long value = std::strtoul(text, &end, 10);
+            if(end == text || value == 0)
+            {
+                return false;
+            }
+            outValues.push_back(unsigned(value));
+            text = *end == ',' ? end + 1 : end;
+        }
+        return !outValues.empty();
+    }
+
+    /**
+     * Find "key": in a line of the JSON this writes and read the string or number after it.
+     * @return False if the key isn't in the line.
+     */
+    bool jsonValue(const std::string& line, const char* const key, std::string& outValue)
+    {
+        const std::string quotedKey = std::string("\"") + key + "\":";
+        const size_t start = line.find(quotedKey);
+        if(start == std::string::npos)
+        {
+            return false;
+        }
+        size_t begin = start + quotedKey.size();
+        size_t end;
+        if(line[begin] == '"')
+        {
+            end = line.find('"', ++begin);
+        }
+        else
+        {
+            end = line.find_first_of(",}", begin);
+        }
+        if(end == std::string::npos)
+        {
+            return false;
+        }
+        outValue = line.substr(begin, end - begin);
+        return true;
+    }
+
+    /**
+     * Read the results of a baseline written by this benchmark, which puts each
+     * result on a line of its own.
+     */
+    std::vector<BenchmarkResult> readBaseline(const char* const path)
+    {
+        std::vector<BenchmarkResult> results;
+        std::ifstream file(path);
+        std::string line;
+        while(std::getline(file, line))
+        {
+            BenchmarkResult result = {};
+            std::string tileDim, maxIters, workers, pixelsPerSecond;
+            if(jsonValue(line, "view", result.view) && jsonValue(line, "tileDim", tileDim) && jsonValue(line, "maxIters", maxIters) &&
+               jsonValue(line, "workers", workers) && jsonValue(line, "pixelsPerSecond", pixelsPerSecond))
+            {
+                // Baselines from before waiting by spinning was measured all used the latch:
+                if(!jsonValue(line, "wait", result.wait))
+                {
+                    result.wait = waitModeName(WaitMode::Latch);
+                }
+                result.tileDim = unsigned(std::strtoul(tileDim.c_str(), nullptr, 10));
+                result.maxIters = unsigned(std::strtoul(maxIters.c_str(), nullptr, 10));
+                result.workers = unsigned(std::strtoul(workers.c_str(), nullptr, 10));
+                result.pixelsPerSecond = std::strtod(pixelsPerSecond.c_str(), nullptr);
+                results.push_back(result);
+            }
+        }
+        return results;
+    }
+
+    /** Wait for every tile by polling its future, keeping this thread busy. */
+    void spinWait(std::vector<stlab::future<async_tiled::Tile2D *>>& tiles)
+    {
+        for(auto& tile : tiles)
+        {
+            while(!tile.get_try())
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    /** The CPU time all the process's threads have taken so far. */
+    double processCpuMs()
+    {
+        return 1000.0 * double(std::clock()) / CLOCKS_PER_SEC;
+    }
+
+    /**
+     * Render frames frames of view, after one to warm up, with tiles of tileDim
+     * pixels, on at most workers of the default executor's threads at once,
+     * waiting for each the way wait says.
+     */
+    BenchmarkResult benchmark(const BenchmarkView& view, const async_tiled::Dims2U framebufferDims, const unsigned tileDim,
+                              const unsigned maxIters, const unsigned workers, const WaitMode wait, const unsigned frames,
+                              async_tiled::MandelbrotOptions options)
+    {
+        const async_tiled::TileSpec spec {
+                async_tiled::TileFormat::RGBA8888,
+                uint16_t(tileDim), uint16_t(tileDim),
+                unsigned(framebufferDims.w * sizeof(async_tiled::RGBA))
+        };
+        const async_tiled::Dims2U tileGridDims = async_tiled::tileGridCovering(spec, framebufferDims);
+        std::vector<async_tiled::Tile2D> tiles;
+        async_tiled::Framebuffer framebuffer(framebufferDims.w * framebufferDims.h);
+        async_tiled::IterationFrame iterations(spec, tileGridDims);
+        const async_tiled::Palette palette = async_tiled::greyPalette(maxIters);
+        std::atomic<async_tiled::Transaction> transaction(0);
+        const async_tiled::PlaneBounds bounds = async_tiled::planeBounds(view.view, framebufferDims.w, framebufferDims.h);
+        async_tiled::TileQueue queue(workers);
+        async_tiled::FrameArena arena;
+        options.queue = &queue;
+        options.arena = &arena;
+
+        std::vector<double> latencies;
+        double cpuMs = 0;
+        std::vector<stlab::future<async_tiled::Tile2D *>> futureTiles;
+        for(unsigned frame = 0; frame <= frames; ++frame)
+        {
+            arena.recycle(std::move(futureTiles));
+            const double startCpuMs = processCpuMs();
+            const auto startTime = std::chrono::steady_clock::now();
+            futureTiles = async_tiled::mandelbrotAsyncTiled(bounds, maxIters, transaction, transaction, tileGridDims, spec, tiles, framebuffer,
+                                                            iterations, palette, options);
+            if(wait == WaitMode::Spin)
+            {
+                spinWait(futureTiles);
+            }
+            else
+            {
+                async_tiled::FrameCompletion(futureTiles).wait();
+            }
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+            // The first frame pays for faulting in the buffers and warming the caches:
+            if(frame > 0)
+            {
+                latencies.push_back(ms);
+                cpuMs += processCpuMs() - startCpuMs;
+            }
+        }
+        arena.recycle(std::move(futureTiles));
+
+        double totalMs = 0;
+        for(const double ms : latencies)
+        {
+            totalMs += ms;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        BenchmarkResult result = {};
+        result.view = view.name;
+        result.tileDim = tileDim;
+        result.maxIters = maxIters;
+        result.workers = workers;
+        result.wait = waitModeName(wait);
+        result.frames = frames;
+        result.fps = 1000.0 * frames / std::max(totalMs, 1e-6);
+        result.pixelsPerSecond = result.fps * framebufferDims.w * framebufferDims.h;
+        result.p50Ms = percentile(latencies, 0.5);
+        result.p90Ms = percentile(latencies, 0.9);
+        result.p99Ms = percentile(latencies, 0.99);
+        result.cpuMsPerFrame = cpuMs / frames;
+        result.cpuCores = cpuMs / std::max(totalMs, 1e-6);
+        result.scalingEfficiency = 1.0;
+        return result;
+    }
+
+    void writeJson(std::ostream& out, const async_tiled::Dims2U framebufferDims, const async_tiled::KernelIsa isa,
+                   const std::vector<BenchmarkResult>& results)
+    {
+        out << "{\n\"benchmark\":\"mandelbrot\",\"width\":" << framebufferDims.w << ",\"height\":" << framebufferDims.h
+            << ",\"kernel\":\"" << async_tiled::kernelIsaName(isa) << "\",\"hardwareThreads\":" << std::thread::hardware_concurrency()
+            << ",\n\"results\":[";
+        for(size_t i = 0; i < results.size(); ++i)
+        {
+            const BenchmarkResult& result = results[i];
+            // A result per line, which readBaseline() relies on:
+            out << (i > 0 ? ",\n" : "\n") << "{\"view\":\"" << result.view << "\",\"tileDim\":" << result.tileDim
+                << ",\"maxIters\":" << result.maxIters << ",\"workers\":" << result.workers << ",\"wait\":\"" << result.wait
+                << "\",\"frames\":" << result.frames << ",\"fps\":" << result.fps << ",\"pixelsPerSecond\":" << result.pixelsPerSecond
+                << ",\"latencyMs\":{\"p50\":" << result.p50Ms << ",\"p90\":" << result.p90Ms << ",\"p99\":" << result.p99Ms
+                << "},\"cpuMsPerFrame\":" << result.cpuMsPerFrame << ",\"cpuCores\":" << result.cpuCores
+                << ",\"scalingEfficiency\":" << result.scalingEfficiency << "}";
+        }
+        out << "\n]}\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // --size=<w>x<h> sets the framebuffer (1024x640 by default), with partial tiles at its edges where a tile size doesn't divide it.
+    // --tiles=<dims>, --iters=<limits> (each at most 65535) and --workers=<counts> are comma separated lists to sweep,
+    // and --views=<names> picks some of interior, full, seahorse and deep-boundary.
+    // --wait=latch|spin,... waits for frames on a FrameCompletion latch, by spinning on the tiles' futures, or (by default)
+    // each in turn, reporting the CPU time each takes.
+    // --frames=<n> times n frames of each configuration after one to warm up.
+    // --kernel=auto|scalar|sse2|avx2|avx512 picks the pixel kernel.
+    // --json=<path> writes the results there rather than to stdout.
+    // --baseline=<path> compares each configuration's pixel rate with that of a result written by an earlier run,
+    // and the benchmark fails if any is more than --tolerance=<fraction> (0.1 by default) slower.
+    async_tiled::Dims2U framebufferDims {1024, 640};
+    std::vector<unsigned> tileDims = {16, 32, 64, 128};
+    std::vector<unsigned> maxIterses = {64, 256, 1024};
+    std::vector<unsigned> workerCounts;
+    const unsigned hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    for(unsigned workers = 1; workers < hardwareThreads; workers *= 2)
+    {
+        workerCounts.push_back(workers);
+    }
+    workerCounts.push_back(hardwareThreads);
+    std::vector<WaitMode> waitModes = {WaitMode::Latch, WaitMode::Spin};
+    std::vector<const BenchmarkView*> views;
+    for(const BenchmarkView& view : BENCHMARK_VIEWS)
+    {
+        views.push_back(&view);
+    }
+    unsigned frames = 10;
+    const char* jsonPath = nullptr;
+    const char* baselinePath = nullptr;
+    double tolerance = 0.1;
+    async_tiled::MandelbrotOptions options;
+
+    // Returns the text after "--name=" if arg starts with it:
+    auto argValue = [](const char* arg, const char* prefix) -> const char* {
+        const size_t length = std::strlen(prefix);
+        return std::strncmp(arg, prefix, length) == 0 ? arg + length : nullptr;
+    };
+    auto parseViews = [&views](const std::string& names) {
+        views.clear();
+        std::istringstream list(names);
+        std::string name;
+        while(std::getline(list, name, ','))
+        {
+            const auto found = std::find_if(std::begin(BENCHMARK_VIEWS), std::end(BENCHMARK_VIEWS),
+                                            [&name](const BenchmarkView& view) { return name == view.name; });
+            if(found == std::end(BENCHMARK_VIEWS))
+            {
+                return false;
+            }
+            views.push_back(found);
+        }
+        return !views.empty();
+    };
+    auto parseWaitModes = [&waitModes](const std::string& names) {
+        waitModes.clear();
+        std::istringstream list(names);
+        std::string name;
+        while(std::getline(list, name, ','))
+        {
+            if(name != waitModeName(WaitMode::Latch) && name != waitModeName(WaitMode::Spin))
+            {
+                return false;
+            }
+            waitModes.push_back(name == waitModeName(WaitMode::Spin) ? WaitMode::Spin : WaitMode::Latch);
+        }
+        return !waitModes.empty();
+    };
+    for(int arg = 1; arg < argc; ++arg)
+    {
+        const char* value = nullptr;
+        if((value = argValue(argv[arg], "--size=")) && std::sscanf(value, "%ux%u", &framebufferDims.w, &framebufferDims.h) == 2 &&
+           framebufferDims.w > 0 && framebufferDims.h > 0)
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--tiles=")) && parseList(value, tileDims))
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--iters=")) && parseList(value, maxIterses) &&
+           *std::max_element(maxIterses.begin(), maxIterses.end()) <= async_tiled::MAX_ITERS)
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--workers=")) && parseList(value, workerCounts))
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--views=")) && parseViews(value))
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--wait=")) && parseWaitModes(value))
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--frames=")) && (frames = unsigned(std::strtoul(value, nullptr, 10))) > 0)
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--kernel=")) && async_tiled::parseKernelIsa(value, options.kernelIsa))
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--json=")) && *value)
+        {
+            jsonPath = value;
+            continue;
+        }
+        if((value = argValue(argv[arg], "--baseline=")) && *value)
+        {
+            baselinePath = value;
+            continue;
+        }
+        if((value = argValue(argv[arg], "--tolerance=")) && (tolerance = std::strtod(value, nullptr)) > 0)
+        {
+            continue;
+        }
+        std::cerr << "Usage: " << argv[0] << " [--size=<w>x<h>] [--tiles=<dim>,...] [--iters=<n>,...] [--workers=<n>,...]"
+                     " [--views=interior|full|seahorse|deep-boundary,...] [--wait=latch|spin,...] [--frames=<n>] [--kernel=auto|scalar|sse2|avx2|avx512]"
+                     " [--json=<path>] [--baseline=<path>] [--tolerance=<fraction>]" << std::endl;
+        return 1;
+    }
+    const async_tiled::MandelbrotKernels& kernels = async_tiled::mandelbrotKernels(options.kernelIsa);
+    options.kernelIsa = kernels.isa;
+    std::sort(workerCounts.begin(), workerCounts.end());
+    std::cerr << "Benchmarking " << framebufferDims.w << "x" << framebufferDims.h << " frames with the "
+              << async_tiled::kernelIsaName(kernels.isa) << " kernel on up to " << hardwareThreads << " hardware threads." << std::endl;
+
+    std::vector<BenchmarkResult> results;
+    for(const BenchmarkView* const view : views)
+    {
+        for(const unsigned tileDim : tileDims)
+        {
+            if(tileDim > UINT16_MAX)
+            {
+                std::cerr << "Skipping " << tileDim << " pixel tiles, which are too big for a TileSpec." << std::endl;
+                continue;
+            }
+            for(const unsigned maxIters : maxIterses)
+            {
+                for(const WaitMode wait : waitModes)
+                {
+                    // Workers are swept innermost, so each configuration's scaling is against its own fewest workers:
+                    const size_t fewestWorkers = results.size();
+                    for(const unsigned workers : workerCounts)
+                    {
+                        BenchmarkResult result = benchmark(*view, framebufferDims, tileDim, maxIters, workers, wait, frames, options);
+                        const BenchmarkResult& fewest = results.size() > fewestWorkers ? results[fewestWorkers] : result;
+                        result.scalingEfficiency = (result.fps / fewest.fps) / (double(workers) / fewest.workers);
+                        std::cerr << view->name << ", " << tileDim << " pixel tiles, " << maxIters << " iterations, " << workers << " workers, "
+                                  << result.wait << " wait: " << result.fps << " frames/s, " << result.pixelsPerSecond / 1e6 << " Mpixels/s, latency p50 "
+                                  << result.p50Ms << " ms, p90 " << result.p90Ms << " ms, p99 " << result.p99Ms << " ms, CPU " << result.cpuMsPerFrame
+                                  << " ms/frame on " << result.cpuCores << " cores, scaling efficiency " << result.scalingEfficiency << "." << std::endl;
+                        results.push_back(result);
+                    }
+                }
+            }
+        }
+    }
+
+    if(jsonPath)
+    {
+        std::ofstream file(jsonPath);
+        writeJson(file, framebufferDims, kernels.isa, results);
+        if(!file)
+        {
+            std::cerr << "Couldn't write the results to \"" << jsonPath << "\"." << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        writeJson(std::cout, framebufferDims, kernels.isa, results);
+    }
+
+    if(baselinePath)
+    {
+        const std::vector<BenchmarkResult> baseline = readBaseline(baselinePath);
+        if(baseline.empty())
+        {
+            std::cerr << "No results found in the baseline \"" << baselinePath << "\"." << std::endl;
+            return 1;
+        }
+        unsigned compared = 0;
+        unsigned regressions = 0;
+        for(const BenchmarkResult& result : results)
+        {
+            const auto before = std::find_if(baseline.begin(), baseline.end(), [&result](const BenchmarkResult& base)
+            {
+                return base.view == result.view && base.tileDim == result.tileDim && base.maxIters == result.maxIters && base.workers == result.workers &&
+                       base.wait == result.wait;
+            });
+            if(before == baseline.end() || before->pixelsPerSecond <= 0)
+            {
+                continue;
+            }
+            ++compared;
+            const double ratio = result.pixelsPerSecond / before->pixelsPerSecond;
+            if(ratio < 1.0 - tolerance)
+            {
+                ++regressions;
+                std::cerr << "Slower than the baseline: " << result.view << ", " << result.tileDim << " pixel tiles, " << result.maxIters
+                          << " iterations, " << result.workers << " workers, " << result.wait << " wait ran at " << ratio << " times its pixel rate." << std::endl;
+            }
+            else if(ratio > 1.0 + tolerance)
+            {
+                std::cerr << "Faster than the baseline: " << result.view << ", " << result.tileDim << " pixel tiles, " << result.maxIters
+                          << " iterations, " << result.workers << " workers, " << result.wait << " wait ran at " << ratio << " times its pixel rate." << std::endl;
+            }
+        }
+        std::cerr << "Compared " << compared << " of " << results.size() << " configurations with the baseline, " << regressions
+                  << " more than " << tolerance * 100 << "% slower." << std::endl;
+        if(regressions > 0)
+        {
+            return 2;
+        }
+    }
+    return 0;
+}
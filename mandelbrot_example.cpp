@@ -2,27 +2,59 @@
 // Copyright Andrew Cox 2017. All rights reserved.
 //
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <ctime>
+#include <condition_variable>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
 #include <thread>
 #include <complex>
 #include <functional>
 #include <future>
+#include <tuple>
+#include <unordered_map>
 
 #include "stlab/concurrency/future.hpp"
 #include "stlab/concurrency/default_executor.hpp"
+#include "stlab/concurrency/immediate_executor.hpp"
+
+#include "mandelbrot_kernels.h"
+#include "mandelbrot_perf.h"
+#include "mandelbrot_perturbation.h"
+#include "mandelbrot_trace.h"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb/stb_image_write.h"
 
 // You might want to edit this for your platform:
 constexpr const char * const OUTPUT_PATH_MANDELBROT = "/tmp/stlab-mandelbrot.png";
+constexpr const char * const OUTPUT_PATH_HEATMAP = "/tmp/stlab-mandelbrot-heatmap.png";
+constexpr const char * const OUTPUT_PATH_TILE_CHOICES = "/tmp/stlab-mandelbrot-tiles.txt";
 
 namespace async_tiled {
     using namespace stlab;
 
     enum class TileFormat {
-        RGBA8888 = 1
+        RGBA8888 = 1,
+        /** A uint16_t escape count per pixel. */
+        Iterations16 = 2
     };
 
     /** A byte-per-component pixel. */
@@ -42,6 +74,19 @@ namespace async_tiled {
 
     using Framebuffer = std::vector<RGBA>;
 
+    /** Escape counts, one per pixel, kept so a frame can be recoloured without iterating it again. */
+    using IterationBuffer = std::vector<uint16_t>;
+
+    /** The colour of each escape count from 0 to maxIters. */
+    using Palette = std::vector<RGBA>;
+
+    /**
+     * Identifies the frame tile tasks belong to. Callers bump an atomic one to
+     * abandon the frame in flight. 64 bits so it can't wrap round to a frame
+     * that is still in flight, however many frames are rendered.
+     */
+    using Transaction = uint64_t;
+
     struct Dims2U {
         unsigned w;
         unsigned h;
@@ -59,7 +104,7 @@ namespace async_tiled {
     struct TileSpec {
         TileSpec(const TileFormat pixelFormat, const uint16_t w, const uint16_t h, const unsigned stride) :
                 pixelFormat(pixelFormat), w(w), h(h), stride(stride) {}
-        /** Currently only one format is in use. */
+        /** The pixels a tile holds: colours or escape counts. */
         /// @note We could avoid specifying the format here and let the functions
         /// processing tiles define the data stored in them implicitly.
         const TileFormat pixelFormat = TileFormat::RGBA8888;
@@ -71,6 +116,60 @@ namespace async_tiled {
         const unsigned stride;
     };
 
+    /**
+     * A TileSpec whose tile dimensions are compile time constants. Code templated
+     * on the type of its spec sees these static w and h in place of TileSpec's, so
+     * its loops over a tile's rows and pixels have known trip counts.
+     */
+    template<uint16_t W, uint16_t H>
+    struct FixedTileSpec : TileSpec {
+        /** @param spec Must have tiles of W x H pixels. */
+        explicit FixedTileSpec(const TileSpec& spec) : TileSpec(spec) {}
+        static constexpr uint16_t w = W;
+        static constexpr uint16_t h = H;
+    };
+
+    /**
+     * Call fn with spec as a FixedTileSpec if its tiles are one of the common
+     * square sizes, or as the runtime TileSpec otherwise.
+     */
+    template<typename Fn>
+    auto withFixedTileSpec(const TileSpec& spec, Fn&& fn)
+    {
+        if(spec.w == spec.h)
+        {
+            switch(spec.w)
+            {
+                case 16: return fn(FixedTileSpec<16, 16>(spec));
+                case 32: return fn(FixedTileSpec<32, 32>(spec));
+                case 64: return fn(FixedTileSpec<64, 64>(spec));
+                case 128: return fn(FixedTileSpec<128, 128>(spec));
+                default: break;
+            }
+        }
+        return fn(spec);
+    }
+
+    // Scratch space for a value per pixel of a row or column of a tile or of the whole
+    // tile, on the stack when the tile dims are compile time constants:
+    template<typename T>
+    std::vector<T> rowScratch(const TileSpec& spec) { return std::vector<T>(spec.w); }
+
+    template<typename T, uint16_t W, uint16_t H>
+    std::array<T, W> rowScratch(const FixedTileSpec<W, H>&) { return {}; }
+
+    template<typename T>
+    std::vector<T> columnScratch(const TileSpec& spec) { return std::vector<T>(spec.h); }
+
+    template<typename T, uint16_t W, uint16_t H>
+    std::array<T, H> columnScratch(const FixedTileSpec<W, H>&) { return {}; }
+
+    template<typename T>
+    std::vector<T> tileScratch(const TileSpec& spec) { return std::vector<T>(spec.w * spec.h); }
+
+    template<typename T, uint16_t W, uint16_t H>
+    std::array<T, W * H> tileScratch(const FixedTileSpec<W, H>&) { return {}; }
+
     /**
      * A bundle of pixel data. Derived classes know the format of the pixels and the
      * ownership of them.
@@ -94,16 +193,30 @@ namespace async_tiled {
     };
 
     /**
-     * Work out how big a framebuffer is that uses all tiles in a grid of them.
+     * Work out how many pixels a grid of whole tiles spans. A framebuffer whose
+     * width or height isn't a whole number of tiles is smaller, with partial tiles
+     * at its right and bottom edges: its escape counts are still iterated for whole
+     * tiles, in an IterationFrame this size, and only those inside it are coloured.
      * @param spec
      * @param tileGridDims
-     * @return framebuffer width and height.
+     * @return width and height of the whole tiles.
      */
-    constexpr Dims2U pixelDims(const TileSpec& spec, const Dims2U tileGridDims)
+    template<typename Spec>
+    constexpr Dims2U pixelDims(const Spec& spec, const Dims2U tileGridDims)
     {
         return  {spec.w * tileGridDims.w, spec.h * tileGridDims.h};
     }
 
+    /**
+     * The grid of tiles of spec's dims that covers a framebuffer, including partial
+     * tiles at its right and bottom edges.
+     */
+    template<typename Spec>
+    constexpr Dims2U tileGridCovering(const Spec& spec, const Dims2U framebufferDims)
+    {
+        return {(framebufferDims.w + spec.w - 1) / spec.w, (framebufferDims.h + spec.h - 1) / spec.h};
+    }
+
     /**
      * Work out the address of the leftmost pixel of the given row of a tile.
      * @param spec
@@ -111,8 +224,8 @@ namespace async_tiled {
      * @param y coordinate of row within tile.
      * @return Pointer to the first pixel of the row.
      */
-    template<typename PixelType>
-    constexpr PixelType* addressRow(const TileSpec& spec, const Tile2D& tile, const unsigned y) {
+    template<typename PixelType, typename Spec>
+    constexpr PixelType* addressRow(const Spec& spec, const Tile2D& tile, const unsigned y) {
         PixelType *pixelRow = reinterpret_cast<PixelType *>(tile.pixels + spec.stride * y);
         return pixelRow;
     }
@@ -123,173 +236,3326 @@ namespace async_tiled {
      * @param tile
      * @return Coordinates in framebuffer pixels of the tile upper-left.
      */
-    constexpr Point2U pixelPosition(const TileSpec& spec, const Tile2D& tile)
+    template<typename Spec>
+    constexpr Point2U pixelPosition(const Spec& spec, const Tile2D& tile)
     {
         Point2U position = {unsigned(spec.w) * tile.x, unsigned(spec.h) * tile.y};
         return position;
     }
 
     /**
-     * Launch a function to run asynchronously on each tile of a framebuffer,
-     * where the tiles point into a common framebuffer.
-     * @return A vector of futures of whatever the launched function returns,
-     * which by convention should be references to tiles in outTiles.
+     * The escape counts of a framebuffer, tiled the same way, which the iteration
+     * stage writes and the colorize stage reads.
      */
-    template<typename Executor, typename PixelType, typename Fn, typename... Args>
-    std::vector<stlab::future<typename std::result_of<Fn(const TileSpec& spec, Tile2D& tile, Args&&...)>::type>>
-    LaunchTiles(Executor& ex, const TileSpec &spec, const Dims2U bufferTiles,
-                std::vector<PixelType> &framebuffer,
-                std::vector<Tile2D> &outTiles,
-                Fn &&func, Args &&... args)
+    struct IterationFrame {
+        IterationFrame(const TileSpec& framebufferSpec, const Dims2U tileGridDims) :
+                spec(TileFormat::Iterations16, framebufferSpec.w, framebufferSpec.h, framebufferSpec.w * tileGridDims.w * sizeof(uint16_t)),
+                counts(pixelDims(framebufferSpec, tileGridDims).w * pixelDims(framebufferSpec, tileGridDims).h) {}
+
+        const TileSpec spec;
+        std::vector<Tile2D> tiles;
+        IterationBuffer counts;
+    };
+
+    /** The dims of a framebuffer whose scanlines are spec.stride bytes apart. */
+    inline Dims2U framebufferDimsOf(const TileSpec& spec, const Framebuffer& framebuffer)
     {
-        outTiles.clear();
-        outTiles.reserve(bufferTiles.w * bufferTiles.h);
-        ///@ToDo - Pass this in to be reused.
-        std::vector<stlab::future<typename std::result_of<Fn(const TileSpec& spec, Tile2D& tile, Args...)>::type>> tasks;
-        tasks.reserve(outTiles.size());
-        for(unsigned y = 0; y < bufferTiles.h; ++y)
+        const unsigned w = unsigned(spec.stride / sizeof(RGBA));
+        return {w, unsigned(framebuffer.size() / w)};
+    }
+
+    /** Counts above this saturate in an IterationBuffer. */
+    constexpr uint32_t MAX_STORED_COUNT = UINT16_MAX;
+
+    /**
+     * The highest iteration limit a frame can be rendered with: any higher and
+     * pixels escaping after MAX_STORED_COUNT iterations would be stored with the
+     * same count as the set, and the set would be coloured as escaping.
+     */
+    constexpr unsigned MAX_ITERS = MAX_STORED_COUNT;
+
+    inline void storeCounts(const uint32_t* const iters, const unsigned count, uint16_t* const outCounts)
+    {
+        for (unsigned i = 0; i < count; ++i) {
+            outCounts[i] = uint16_t(std::min(iters[i], MAX_STORED_COUNT));
+        }
+    }
+
+    /** Pixels that escape sooner are brighter, and the set itself is black. */
+    inline Palette greyPalette(const unsigned maxIters)
+    {
+        assert(maxIters <= MAX_ITERS);
+        Palette palette(maxIters + 1);
+        for (unsigned i = 0; i < palette.size(); ++i) {
+            const uint8_t grey = uint8_t(255.0f / maxIters * (maxIters - i));
+            palette[i] = {grey, grey, grey, 255};
+        }
+        return palette;
+    }
+
+    /** Black through red and yellow to white as pixels take longer to escape, with the set black. */
+    inline Palette firePalette(const unsigned maxIters)
+    {
+        assert(maxIters <= MAX_ITERS);
+        Palette palette(maxIters + 1);
+        for (unsigned i = 0; i < palette.size(); ++i) {
+            // Spread the colours over the low counts most pixels escape at:
+            const float t = std::sqrt(float(i) / maxIters);
+            const auto ramp = [t](const float start) { return unsigned(255.0f * std::min(std::max((t - start) * 3.0f, 0.0f), 1.0f)); };
+            palette[i] = i < maxIters ? RGBA(ramp(0.0f), ramp(1.0f / 3), ramp(2.0f / 3), 255) : RGBA(0, 0, 0, 255);
+        }
+        return palette;
+    }
+
+    static_assert(sizeof(RGBA) == sizeof(uint32_t), "The colorize kernels treat pixels as 32 bit words.");
+
+    /**
+     * Look up the colours of one tile's escape counts. The tiles' dims are taken from
+     * countsSpec, less any part of a partial tile outside the framebuffer.
+     */
+    template<typename CountsSpec>
+    void colorizeTile(const CountsSpec& countsSpec, const Tile2D& counts, const TileSpec& spec, Tile2D& tile, const Dims2U framebufferDims,
+                      const Palette& palette, const ColorizeKernel colorize)
+    {
+        const Point2U position = pixelPosition(countsSpec, counts);
+        const unsigned rows = std::min<unsigned>(countsSpec.h, framebufferDims.h - position.y);
+        const unsigned columns = std::min<unsigned>(countsSpec.w, framebufferDims.w - position.x);
+        for (unsigned y = 0; y < rows; ++y) {
+            colorize(addressRow<uint16_t>(countsSpec, counts, y), columns,
+                     reinterpret_cast<const uint32_t*>(&palette[0]), unsigned(palette.size()), addressRow<uint32_t>(spec, tile, y));
+        }
+    }
+
+    /**
+     * Recolour a whole frame from its escape counts, as when the palette changes.
+     * This costs a lookup per pixel rather than a render.
+     */
+    inline void recolor(const IterationFrame& iterations, Framebuffer& framebuffer, const Dims2U framebufferDims,
+                        const Palette& palette, const ColorizeKernel colorize)
+    {
+        // The counts of partial tiles run on past the framebuffer's right edge:
+        const unsigned countsWidth = unsigned(iterations.spec.stride / sizeof(uint16_t));
+        for (unsigned y = 0; y < framebufferDims.h; ++y) {
+            colorize(&iterations.counts[y * countsWidth], framebufferDims.w,
+                     reinterpret_cast<const uint32_t*>(&palette[0]), unsigned(palette.size()), reinterpret_cast<uint32_t*>(&framebuffer[y * framebufferDims.w]));
+        }
+    }
+
+    /** Tiles whose corners are within this many pixels of each other share a TileCache entry. */
+    constexpr double TILE_CACHE_QUANTUM = 1.0 / 16;
+
+    constexpr int TILE_KEY_SPACING_BITS = 24;
+
+    /** What the escape counts of a tile depend on, so tiles of views visited again can be found in a TileCache. */
+    struct TileKey {
+        /**
+         * The tile's top left corner in units of TILE_CACHE_QUANTUM pixels, rounded to
+         * a whole number held as a high and a low double so that deep views don't
+         * run out of bits.
+         */
+        double cornerRe[2];
+        double cornerIm[2];
+        /** The pixel spacings, with their mantissas rounded to TILE_KEY_SPACING_BITS bits. */
+        double spacingX;
+        double spacingY;
+        uint16_t w;
+        uint16_t h;
+        unsigned maxIters;
+        Precision precision;
+        /** Subdivision fills some pixels with their neighbours' counts, so can differ from iterating them. */
+        bool subdivide;
+        /** Cycle detection calls some pixels interior that iterating would see escape after many iterations. */
+        bool interiorChecks;
+
+        bool operator==(const TileKey& rhs) const
         {
-            for(unsigned x = 0; x < bufferTiles.w; ++x)
+            return cornerRe[0] == rhs.cornerRe[0] && cornerRe[1] == rhs.cornerRe[1] &&
+                   cornerIm[0] == rhs.cornerIm[0] && cornerIm[1] == rhs.cornerIm[1] &&
+                   spacingX == rhs.spacingX && spacingY == rhs.spacingY && w == rhs.w && h == rhs.h &&
+                   maxIters == rhs.maxIters && precision == rhs.precision && subdivide == rhs.subdivide &&
+                   interiorChecks == rhs.interiorChecks;
+        }
+    };
+
+    struct TileKeyHash {
+        size_t operator()(const TileKey& key) const
+        {
+            const std::hash<double> hashDouble;
+            size_t hash = std::hash<unsigned>()(key.maxIters) ^ (size_t(key.w) << 16) ^ (size_t(key.h) << 32) ^
+                          (size_t(key.precision) << 48) ^ (size_t(key.subdivide) << 56) ^ (size_t(key.interiorChecks) << 57);
+            for(const double value : {key.cornerRe[0], key.cornerRe[1], key.cornerIm[0], key.cornerIm[1], key.spacingX, key.spacingY})
             {
-                uint8_t * const tile_corner = reinterpret_cast<uint8_t*>(&framebuffer[0]) + y * spec.h * spec.stride + x * spec.w * sizeof(PixelType);
-                outTiles.emplace(outTiles.end(), tile_corner, uint16_t(x), uint16_t(y));
-                auto task = stlab::async(ex, std::forward<Fn>(func), spec, std::ref(outTiles.back()), std::forward<Args>(args)...);
-                tasks.push_back(std::move(task));
+                hash = hash * 1099511628211u ^ hashDouble(value);
             }
+            return hash;
         }
-        return tasks;
-    }
+    };
 
-    // Define the code to run on each tile:
-    auto tileMandelbrotLambda = [ ]
-           (const TileSpec &spec,
-            Tile2D &tile,
-            const float top, const float left, const float bottom, const float right,
-            const unsigned maxIters,
-            const Dims2U framebufferDims,
-            const uint16_t originalTransaction,
-            std::atomic<uint16_t>& transaction
-           ) -> Tile2D *
+    /**
+     * An in-process cache of the escape counts of finished tiles, most recently used
+     * first, holding at most a byte budget of them. Safe to use from any thread.
+     */
+    class TileCache {
+    public:
+        struct Stats {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+            size_t entries = 0;
+            size_t bytes = 0;
+        };
+
+        /** @param byteBudget The most the cached counts and their bookkeeping may take. */
+        explicit TileCache(const size_t byteBudget) : byteBudget(byteBudget) {}
+
+        /**
+         * Copy the counts cached for key into a tile of spec's dims.
+         * @return false, counting a miss, if they aren't cached.
+         */
+        template<typename Spec>
+        bool fetch(const TileKey& key, const Spec& spec, Tile2D& tile)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const auto found = index.find(key);
+            if(found == index.end())
+            {
+                ++counters.misses;
+                return false;
+            }
+            ++counters.hits;
+            entries.splice(entries.begin(), entries, found->second);
+            const std::vector<uint16_t>& counts = found->second->counts;
+            for(unsigned y = 0; y < spec.h; ++y)
+            {
+                std::copy(&counts[y * spec.w], &counts[y * spec.w] + spec.w, addressRow<uint16_t>(spec, tile, y));
+            }
+            return true;
+        }
+
+        /** Cache the counts of a finished tile, evicting the least recently used ones to make room. */
+        template<typename Spec>
+        void store(const TileKey& key, const Spec& spec, const Tile2D& tile)
+        {
+            std::vector<uint16_t> counts(spec.w * spec.h);
+            for(unsigned y = 0; y < spec.h; ++y)
+            {
+                const uint16_t* const row = addressRow<const uint16_t>(spec, tile, y);
+                std::copy(row, row + spec.w, &counts[y * spec.w]);
+            }
+            const size_t bytes = entryBytes(counts);
+            std::lock_guard<std::mutex> lock(mutex);
+            if(bytes > byteBudget || index.count(key))
+            {
+                return;
+            }
+            while(counters.bytes + bytes > byteBudget)
+            {
+                counters.bytes -= entryBytes(entries.back().counts);
+                index.erase(entries.back().key);
+                entries.pop_back();
+                ++counters.evictions;
+            }
+            entries.push_front({key, std::move(counts)});
+            index.emplace(key, entries.begin());
+            counters.bytes += bytes;
+        }
+
+        Stats stats() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Stats stats = counters;
+            stats.entries = entries.size();
+            return stats;
+        }
+
+    private:
+        struct Entry {
+            TileKey key;
+            std::vector<uint16_t> counts;
+        };
+
+        /** The counts and a rough allowance for the list node and the index entry. */
+        static size_t entryBytes(const std::vector<uint16_t>& counts)
+        {
+            return counts.size() * sizeof(uint16_t) + sizeof(Entry) + sizeof(TileKey) + 4 * sizeof(void*);
+        }
+
+        const size_t byteBudget;
+        mutable std::mutex mutex;
+        std::list<Entry> entries;
+        std::unordered_map<TileKey, std::list<Entry>::iterator, TileKeyHash> index;
+        Stats counters;
+    };
+
+    /**
+     * A TileCache as seen by the tiles of one frame: works out each tile's key from
+     * its position, and only caches tiles the frame finished before being abandoned.
+     */
+    class FrameTileCache {
+    public:
+        FrameTileCache(TileCache& cache, const PlaneBounds& bounds, const Dims2U framebufferDims,
+                       const unsigned maxIters, const Precision precision, const bool subdivide, const bool interiorChecks,
+                       const Transaction originalTransaction, std::atomic<Transaction>& transaction) :
+                cache(cache), left(bounds.left), top(bounds.top),
+                spacingX(divide(bounds.right - bounds.left, double(framebufferDims.w))),
+                spacingY(divide(bounds.bottom - bounds.top, double(framebufferDims.h))),
+                maxIters(maxIters), precision(precision), subdivide(subdivide), interiorChecks(interiorChecks),
+                originalTransaction(originalTransaction), transaction(transaction) {}
+
+        template<typename Spec>
+        bool fetch(const Spec& spec, Tile2D& tile) const
+        {
+            return cache.fetch(key(spec, tile), spec, tile);
+        }
+
+        template<typename Spec>
+        void store(const Spec& spec, const Tile2D& tile) const
+        {
+            if(transaction == originalTransaction)
+            {
+                cache.store(key(spec, tile), spec, tile);
+            }
+        }
+
+    private:
+        template<typename Spec>
+        TileKey key(const Spec& spec, const Tile2D& tile) const
+        {
+            const Point2U position = pixelPosition(spec, tile);
+            TileKey key;
+            quantize(left + spacingX * QuadDouble{{double(position.x), 0.0, 0.0, 0.0}}, spacingX.x[0], key.cornerRe);
+            quantize(top + spacingY * QuadDouble{{double(position.y), 0.0, 0.0, 0.0}}, spacingY.x[0], key.cornerIm);
+            key.spacingX = roundMantissa(spacingX.x[0]);
+            key.spacingY = roundMantissa(spacingY.x[0]);
+            key.w = spec.w;
+            key.h = spec.h;
+            key.maxIters = maxIters;
+            key.precision = precision;
+            key.subdivide = subdivide;
+            key.interiorChecks = interiorChecks;
+            return key;
+        }
+
+        /** coordinate / (spacing * TILE_CACHE_QUANTUM), rounded to a whole number held as two doubles. */
+        static void quantize(const QuadDouble& coordinate, const double spacing, double (&outQuanta)[2])
+        {
+            const QuadDouble quanta = divide(coordinate, spacing * TILE_CACHE_QUANTUM);
+            outQuanta[0] = std::round(quanta.x[0]) + 0.0;
+            // A whole high part leaves the fraction to the low one:
+            outQuanta[1] = outQuanta[0] == quanta.x[0] ? std::round(quanta.x[1]) + 0.0 : 0.0;
+        }
+
+        static double roundMantissa(const double value)
+        {
+            int exponent = 0;
+            const double mantissa = std::frexp(value, &exponent);
+            return std::ldexp(std::round(std::ldexp(mantissa, TILE_KEY_SPACING_BITS)), exponent - TILE_KEY_SPACING_BITS);
+        }
+
+        TileCache& cache;
+        const QuadDouble left;
+        const QuadDouble top;
+        const QuadDouble spacingX;
+        const QuadDouble spacingY;
+        const unsigned maxIters;
+        const Precision precision;
+        const bool subdivide;
+        const bool interiorChecks;
+        const Transaction originalTransaction;
+        std::atomic<Transaction>& transaction;
+    };
+
+    /** The order tiles are handed to the executor in, and so roughly the order they finish in. */
+    enum class TileOrder {
+        /** Left to right along each row of tiles from the top. */
+        RowMajor,
+        /** Outwards from the centre of the framebuffer a ring of tiles at a time. */
+        Spiral,
+        /**
+         * Along a Hilbert curve, so tiles launched close together in time are close
+         * together in the framebuffer and share its cache lines.
+         */
+        Hilbert,
+        /** Nearest first to a point of interest. */
+        Focus,
+        /**
+         * Most expensive first, as estimated by iterating a few samples of each
+         * tile, so no expensive tile starts late and holds up the end of the frame.
+         * Not handled by tileOrder(); see costliestFirst().
+         */
+        Costliest
+    };
+
+    /**
+     * The row-major indices of a grid of tiles in the order to launch them.
+     * @param focus The tile Focus order starts from.
+     */
+    inline std::vector<unsigned> tileOrder(const TileOrder order, const Dims2U bufferTiles, const Point2U focus = {0, 0})
     {
-       //std::cerr << std::endl << "Tile " << tile.x << ", " << tile.y;
-        std::cerr << (std::string("\nTile ") + std::to_string(tile.x) + ", " + std::to_string(tile.y));
-        const Point2U framebufferPosition = pixelPosition(spec, tile);
-        for (unsigned y = 0; y < spec.h; ++y) {
-            // Allow cancelation per scanline so we don't burn cycles if this tile becomes
-            // out of date before it is even fully generated:
-            if(transaction != originalTransaction)
+        std::vector<unsigned> indices;
+        indices.reserve(bufferTiles.w * bufferTiles.h);
+        if(order == TileOrder::Hilbert)
+        {
+            unsigned side = 1;
+            while(side < bufferTiles.w || side < bufferTiles.h)
             {
-                break;
+                side *= 2;
             }
-            const unsigned framebufferY = framebufferPosition.y + y;
-            const float j = top + (bottom - top) / framebufferDims.h * framebufferY;
-            RGBA *const pixelRow = addressRow<RGBA>(spec, tile, y);
-            for (unsigned x = 0; x < spec.w; ++x) {
-                const unsigned frameBufferX = framebufferPosition.x + x;
-                const float i = left + (right - left) / framebufferDims.w * frameBufferX;
-                const std::complex<float> c = {i, j};
-                std::complex<float> z = {0, 0};
-                unsigned iter = 0;
-                for (; iter < maxIters; ++iter) {
-                    z = z * z + c;
-                    if (fabsf(z.real() * z.imag()) >= 4.0f) {
-                        break;
+            // Walk the curve over the smallest power of two square covering the grid,
+            // skipping the part outside it:
+            for(unsigned d = 0; d < side * side; ++d)
+            {
+                unsigned x = 0;
+                unsigned y = 0;
+                for(unsigned s = 1, t = d; s < side; s *= 2, t /= 4)
+                {
+                    const unsigned rx = 1 & (t / 2);
+                    const unsigned ry = 1 & (t ^ rx);
+                    if(ry == 0)
+                    {
+                        if(rx == 1)
+                        {
+                            x = s - 1 - x;
+                            y = s - 1 - y;
+                        }
+                        std::swap(x, y);
                     }
+                    x += s * rx;
+                    y += s * ry;
+                }
+                if(x < bufferTiles.w && y < bufferTiles.h)
+                {
+                    indices.push_back(y * bufferTiles.w + x);
                 }
-                const uint8_t grey = uint8_t(255.0f / maxIters * (maxIters - iter));
-                pixelRow[x] = {grey, grey, grey, 255};
             }
+            return indices;
         }
-        // Use this to delay tiles by a screen position dependent amount and so see them load progressively:
-        // std::this_thread::sleep_for(std::chrono::milliseconds(1*tile.x*tile.y));
-        return &tile;
-    };
+        for(unsigned i = 0; i < bufferTiles.w * bufferTiles.h; ++i)
+        {
+            indices.push_back(i);
+        }
+        // Offsets from the centre of the focus tile, or of the grid, in half tiles so they are whole:
+        const int centreX2 = order == TileOrder::Focus ? int(2 * focus.x + 1) : int(bufferTiles.w);
+        const int centreY2 = order == TileOrder::Focus ? int(2 * focus.y + 1) : int(bufferTiles.h);
+        auto offsetX2 = [&](const unsigned i) { return int(2 * (i % bufferTiles.w) + 1) - centreX2; };
+        auto offsetY2 = [&](const unsigned i) { return int(2 * (i / bufferTiles.w) + 1) - centreY2; };
+        if(order == TileOrder::Spiral)
+        {
+            // By ring, then clockwise around each ring from the left:
+            auto ring = [&](const unsigned i) { return std::max(std::abs(offsetX2(i)), std::abs(offsetY2(i))); };
+            std::stable_sort(indices.begin(), indices.end(), [&](const unsigned a, const unsigned b) {
+                const int ringA = ring(a);
+                const int ringB = ring(b);
+                if(ringA != ringB)
+                {
+                    return ringA < ringB;
+                }
+                return std::atan2(-offsetY2(a), -offsetX2(a)) < std::atan2(-offsetY2(b), -offsetX2(b));
+            });
+        }
+        else if(order == TileOrder::Focus)
+        {
+            auto distance2 = [&](const unsigned i) { return offsetX2(i) * offsetX2(i) + offsetY2(i) * offsetY2(i); };
+            std::stable_sort(indices.begin(), indices.end(), [&](const unsigned a, const unsigned b) {
+                return distance2(a) < distance2(b);
+            });
+        }
+        return indices;
+    }
+
+    /** Costliest order samples this many pixels along each side of a tile. */
+    constexpr unsigned PROBE_SAMPLES = 4;
 
     /**
-     * Draw a mandelbrot set, making each tile of the image its own async task.
-     **/
-    std::vector <stlab::future<Tile2D *>> mandelbrotAsyncTiled(
-            const float left, const float right, const float top, const float bottom,
-            const unsigned maxIters,
-            const uint16_t originalTransaction,
-            /// When this no longer matches originalTransaction, the async operations will be abandoned.
-            std::atomic<uint16_t>& transaction,
-            const Dims2U tileGridDims, const TileSpec &spec, std::vector <Tile2D>& tiles, Framebuffer &framebuffer)
+     * Estimate the cost of iterating each tile of a grid by iterating PROBE_SAMPLES
+     * squared evenly spaced pixels of it, as the total escape count of the samples.
+     * @param coords The coordinates of a framebuffer of the probe's samples, i.e.
+     * PROBE_SAMPLES pixels per tile each way.
+     * Interior checks are left off: a tile's worth of pixels deep in the set is
+     * rated costly even though the checks make it cheap, since a sample that
+     * reached maxIters might equally be a costly one on the set's boundary.
+     */
+    template<typename Coords, typename Kernel>
+    std::vector<uint64_t> probeTileCosts(const Coords& coords, const Kernel rowKernel, const Dims2U bufferTiles, const unsigned maxIters)
     {
-        const Dims2U framebufferDims = pixelDims(spec, tileGridDims);
-        
-        std::vector <stlab::future<Tile2D *>> futureTiles =
-                LaunchTiles(default_executor, spec, tileGridDims, framebuffer, tiles, tileMandelbrotLambda, top, left, bottom, right, maxIters, framebufferDims, originalTransaction, std::ref(transaction));
-
-        return futureTiles;
+        const unsigned probeWidth = bufferTiles.w * PROBE_SAMPLES;
+        std::vector<uint32_t> iters(probeWidth);
+        std::vector<uint64_t> costs(bufferTiles.w * bufferTiles.h);
+        for (unsigned y = 0; y < bufferTiles.h * PROBE_SAMPLES; ++y) {
+            rowKernel(coords.left, coords.stepX, 0, coords.top, coords.stepY, y, probeWidth, maxIters, &iters[0], nullptr);
+            for (unsigned x = 0; x < probeWidth; ++x) {
+                // Every pixel costs its escape count and the setup around it:
+                costs[(y / PROBE_SAMPLES) * bufferTiles.w + x / PROBE_SAMPLES] += iters[x] + 1;
+            }
+        }
+        return costs;
     }
 
-} // async_tiled
+    /** The row-major indices of tiles in order of decreasing cost, keeping row-major order among equals. */
+    inline std::vector<unsigned> costliestFirst(const std::vector<uint64_t>& costs)
+    {
+        std::vector<unsigned> indices(costs.size());
+        for(unsigned i = 0; i < indices.size(); ++i)
+        {
+            indices[i] = i;
+        }
+        std::stable_sort(indices.begin(), indices.end(), [&costs](const unsigned a, const unsigned b) {
+            return costs[a] > costs[b];
+        });
+        return indices;
+    }
 
-int main()
-{
-    constexpr unsigned tileDim = 32;
-    constexpr async_tiled::Dims2U framebufferDims { 2048, 1280 };
-    const async_tiled::Dims2U tileGridDims {framebufferDims.w / tileDim, framebufferDims.h / tileDim};
-    const async_tiled::TileSpec spec {
-            async_tiled::TileFormat::RGBA8888,
-            tileDim, tileDim,
-            framebufferDims.w * sizeof(async_tiled::RGBA)
-    };
-    std::vector <async_tiled::Tile2D> tiles;
-    async_tiled::Framebuffer framebuffer(framebufferDims.w * framebufferDims.h);
-    std::atomic<uint16_t> transaction(0);
+    /** The fewest scanlines a band of a split tile may have. */
+    constexpr unsigned MIN_BAND_ROWS = 4;
 
-    // Spawn background tasks to compute the Mandelbrot set over rectangular tiles of the framebuffer:
-    auto futureTiles = async_tiled::mandelbrotAsyncTiled(-2, 1, 1.5001f, -1.4999f, 32, transaction, transaction, tileGridDims, spec, tiles, framebuffer);
-
-    // Use stlab::wait_all() to set a variable when all tasks have completed:
-#if 0
-    using WaitContainer = std::vector <async_tiled::Tile2D *>;
-    std::atomic<uint32_t> done { 0 };
-    auto doneTrigger = [&done](const WaitContainer& futures){
-        std::cerr << "\nDone " << futures.size() << " tiles." << std::endl;
-        done = 1;
-    };
-
-    // Note, you must capture the future returned from `when_all()` into a variable
-    // otherwise your completion functor will not fire.
-    auto range = std::make_pair(futureTiles.begin(), futureTiles.end());
-    auto futureAll = stlab::when_all(stlab::default_executor, doneTrigger, range);
-    assert(futureAll.valid() == true);
-    assert(futureAll.error().is_initialized() == false);
-    std::cerr << std::endl;
-
-    // Yield this processor to background tasks until they are all completed:
-    while(!done) {
-        std::this_thread::yield();
-        //std::this_thread::sleep_for(std::chrono::milliseconds(7));
-        std::cerr << " <*>";
-    };
-#endif
+    /** A split tile's bands each cost at most this fraction of one worker's share of a frame. */
+    constexpr unsigned BAND_SHARE_DIVISOR = 4;
 
-    // An alternative wait for all futures to be ready, more suitable to this usage:
-    unsigned complete = 0;
-    for(auto& future : futureTiles)
+    /**
+     * How many bands of scanlines to split each tile into, by its cost from
+     * probeTileCosts(), so that no task is worth more than 1 / BAND_SHARE_DIVISOR of
+     * what each of workers would do given a perfectly even share of the frame.
+     * Otherwise a frame can't finish before its costliest tile does, however the
+     * tiles are ordered. Band counts are powers of two that divide tileHeight into
+     * bands of at least MIN_BAND_ROWS scanlines.
+     */
+    inline std::vector<uint8_t> tileBands(const std::vector<uint64_t>& costs, const unsigned workers, const unsigned tileHeight)
     {
-        test_future:
-        assert(future.valid());
-        auto res = future.get_try();
-        if(res){
-            ++complete;
-        } else {
-            std::cerr << " <*>";
-            std::this_thread::yield();
-            goto test_future;
+        uint64_t total = 0;
+        for(const uint64_t cost : costs)
+        {
+            total += cost;
+        }
+        const uint64_t bandCost = std::max<uint64_t>(1, total / (uint64_t(std::max(workers, 1u)) * BAND_SHARE_DIVISOR));
+        std::vector<uint8_t> bands(costs.size(), 1);
+        for(unsigned i = 0; i < costs.size(); ++i)
+        {
+            unsigned count = 1;
+            while(costs[i] > count * bandCost && tileHeight % (count * 2) == 0 && tileHeight / (count * 2) >= MIN_BAND_ROWS && count < 128)
+            {
+                count *= 2;
+            }
+            bands[i] = uint8_t(count);
         }
+        return bands;
     }
 
-    std::cerr << std::endl << "Num complete = " << complete << " of " << futureTiles.size() << std::endl;
+    /**
+     * Run a task of tile's on ex. Executors that can drop a task of an abandoned
+     * frame without running it, such as TileQueue::Executor, overload this.
+     */
+    template<typename Executor, typename F>
+    stlab::future<Tile2D *> asyncTile(Executor& ex, Tile2D* /* tile */, F&& f)
+    {
+        return stlab::async(ex, std::forward<F>(f));
+    }
 
-    std::cerr << "Saving image as PNG at \"" << OUTPUT_PATH_MANDELBROT << "\" ... ";
-    auto pngResult = stbi_write_png(OUTPUT_PATH_MANDELBROT, framebufferDims.w, framebufferDims.h, 4, &framebuffer[0], framebufferDims.w * sizeof(async_tiled::RGBA));
-    std::cerr << "PNG write result: " << pngResult << std::endl;
+    /**
+     * Run func asynchronously on a tile or, if bands is more than one, on each of
+     * that many bands of its scanlines as tasks of their own. Each band is passed
+     * to func as a tile of a grid of tiles bands times shorter than spec's, so func
+     * must only use the tile's pixels and position as the tile functions here do.
+     * @return A future of the tile, ready once every band is.
+     */
+    template<typename Executor, typename Spec, typename Fn, typename... Args>
+    stlab::future<Tile2D *> LaunchTileBands(Executor& ex, const Spec &spec, Tile2D &tile, const unsigned bands,
+                                            Fn &&func, const Args &... args)
+    {
+        traceInstant("enqueue", tile.x, tile.y);
+        if(bands <= 1)
+        {
+            return asyncTile(ex, &tile, [spec, &tile, func, args...]() mutable -> Tile2D *
+            {
+                return func(spec, tile, args...);
+            });
+        }
+        const TileSpec bandSpec(spec.pixelFormat, spec.w, uint16_t(spec.h / bands), spec.stride);
+        Tile2D* const whole = &tile;
+        std::vector<stlab::future<Tile2D *>> bandTasks;
+        bandTasks.reserve(bands);
+        for(unsigned band = 0; band < bands; ++band)
+        {
+            Tile2D bandTile(addressRow<uint8_t>(spec, tile, band * bandSpec.h), tile.x, uint16_t(tile.y * bands + band));
+            bandTasks.push_back(asyncTile(ex, whole, [bandSpec, bandTile, whole, func, args...]() mutable -> Tile2D *
+            {
+                func(bandSpec, bandTile, args...);
+                return whole;
+            }));
+        }
+        // Joining the bands is trivial, so shouldn't queue behind other tiles:
+        return stlab::when_all(immediate_executor, [](const std::vector<Tile2D *>& done) { return done.front(); },
+                               std::make_pair(bandTasks.begin(), bandTasks.end()));
+    }
 
-    std::cerr << std::endl << "Exiting." << std::endl;
-    return 0;
-}
+    /**
+     * Launch a function to run asynchronously on each tile of a framebuffer,
+     * where the tiles point into a common framebuffer.
+     * @param framebuffer Must span whole tiles, pixelDims(spec, bufferTiles), as an
+     * IterationFrame's counts do, since func fills whole tiles. To render a frame
+     * that isn't a whole number of tiles across or down, iterate whole tiles of
+     * counts over the grid that covers it and colour only the part inside it.
+     * @param tasks Filled with a future per tile of outTiles, in row-major order
+     * whatever order the tiles were launched in. Pass storage from
+     * FrameArena::futures() so that a frame needn't allocate it.
+     * @param launchOrder The row-major index of each tile in the order to launch them,
+     * from tileOrder(). The futures of tiles it leaves out are left invalid.
+     * @param bands For each tile in row-major order, how many bands of scanlines to
+     * split it into with LaunchTileBands(), from tileBands(). Empty to split none.
+     * @param cache If not null, tiles found in it are copied from it rather than
+     * launched, and given ready futures, and the tiles launched are stored in it
+     * once they finish.
+     * @param func Returns the tile it was given.
+     */
+    template<typename Executor, typename Spec, typename PixelType, typename Fn, typename... Args>
+    void
+    LaunchTiles(Executor& ex, const Spec &spec, const Dims2U bufferTiles,
+                std::vector<PixelType> &framebuffer,
+                std::vector<Tile2D> &outTiles,
+                std::vector<stlab::future<Tile2D *>> &tasks,
+                const std::vector<unsigned> &launchOrder,
+                const std::vector<uint8_t> &bands,
+                const std::shared_ptr<const FrameTileCache> &cache,
+                Fn &&func, Args &&... args)
+    {
+        assert(framebuffer.size() * sizeof(PixelType) >= size_t(pixelDims(spec, bufferTiles).h) * spec.stride);
+        outTiles.clear();
+        outTiles.reserve(bufferTiles.w * bufferTiles.h);
+        for(unsigned y = 0; y < bufferTiles.h; ++y)
+        {
+            for(unsigned x = 0; x < bufferTiles.w; ++x)
+            {
+                uint8_t * const tile_corner = reinterpret_cast<uint8_t*>(&framebuffer[0]) + y * spec.h * spec.stride + x * spec.w * sizeof(PixelType);
+                outTiles.emplace(outTiles.end(), tile_corner, uint16_t(x), uint16_t(y));
+            }
+        }
+        tasks.assign(outTiles.size(), stlab::future<Tile2D *>());
+        for(const unsigned i : launchOrder)
+        {
+            if(cache && cache->fetch(spec, outTiles[i]))
+            {
+                tasks[i] = stlab::make_ready_future(&outTiles[i], immediate_executor);
+                continue;
+            }
+            tasks[i] = LaunchTileBands(ex, spec, outTiles[i], bands.empty() ? 1 : bands[i], func, args...);
+            if(cache)
+            {
+                tasks[i] = tasks[i].then(immediate_executor, [cache, spec](Tile2D* const tile) -> Tile2D *
+                {
+                    cache->store(spec, *tile);
+                    return tile;
+                });
+            }
+        }
+    }
+
+    /**
+     * Like LaunchTiles, but each tile's function is a continuation of a shared
+     * prerequisite future and receives its value after the tile, so per-frame setup
+     * can run once and be read by every tile.
+     */
+    template<typename Executor, typename Prerequisite, typename Spec, typename PixelType, typename Fn, typename... Args>
+    std::vector<stlab::future<typename std::result_of<Fn(const Spec& spec, Tile2D& tile, const Prerequisite&, Args&&...)>::type>>
+    LaunchTilesAfter(Executor& ex, const stlab::future<Prerequisite>& prerequisite,
+                     const Spec &spec, const Dims2U bufferTiles,
+                     std::vector<PixelType> &framebuffer,
+                     std::vector<Tile2D> &outTiles,
+                     Fn &&func, Args &&... args)
+    {
+        outTiles.clear();
+        outTiles.reserve(bufferTiles.w * bufferTiles.h);
+        std::vector<stlab::future<typename std::result_of<Fn(const Spec& spec, Tile2D& tile, const Prerequisite&, Args...)>::type>> tasks;
+        tasks.reserve(bufferTiles.w * bufferTiles.h);
+        for(unsigned y = 0; y < bufferTiles.h; ++y)
+        {
+            for(unsigned x = 0; x < bufferTiles.w; ++x)
+            {
+                uint8_t * const tile_corner = reinterpret_cast<uint8_t*>(&framebuffer[0]) + y * spec.h * spec.stride + x * spec.w * sizeof(PixelType);
+                outTiles.emplace(outTiles.end(), tile_corner, uint16_t(x), uint16_t(y));
+                auto task = prerequisite.then(ex, std::bind(func, spec, std::ref(outTiles.back()), std::placeholders::_1, args...));
+                tasks.push_back(std::move(task));
+            }
+        }
+        return tasks;
+    }
+
+    /**
+     * Like LaunchTiles, but on tiles already made by an earlier launch, each one
+     * running as a continuation of its own prerequisite future, so a tile can be
+     * worked on again as soon as the earlier work on it is done.
+     * @param prerequisites A future per tile in tiles, in the same order.
+     * @param tasks Filled with a future per tile in tiles, in the same order.
+     */
+    template<typename Executor, typename Spec, typename Fn, typename... Args>
+    void
+    LaunchTilesAfterEach(Executor& ex, const std::vector<stlab::future<Tile2D *>>& prerequisites,
+                         const Spec &spec, std::vector<Tile2D> &tiles,
+                         std::vector<stlab::future<Tile2D *>> &tasks,
+                         Fn &&func, const Args &... args)
+    {
+        tasks.clear();
+        tasks.reserve(tiles.size());
+        for(unsigned i = 0; i < tiles.size(); ++i)
+        {
+            Tile2D* const tile = &tiles[i];
+            tasks.push_back(prerequisites[i].then(ex, [spec, tile, func, args...](Tile2D *) mutable -> Tile2D *
+            {
+                return func(spec, *tile, args...);
+            }));
+        }
+    }
+
+    /**
+     * Like LaunchTiles, but exploits the set's symmetry about the real axis: a tile
+     * whose every scanline is the mirror image of one in an earlier tile row isn't
+     * computed. Instead it is filled with a row-reversed copy of those scanlines as a
+     * continuation of the one or two tiles that hold them.
+     * @param mirrorAxis Framebuffer scanline y mirrors scanline mirrorAxis - y.
+     */
+    template<typename Executor, typename Spec, typename PixelType, typename Fn, typename... Args>
+    void
+    LaunchTilesMirrored(Executor& ex, const Spec &spec, const Dims2U bufferTiles,
+                        std::vector<PixelType> &framebuffer,
+                        std::vector<Tile2D> &outTiles,
+                        std::vector<stlab::future<Tile2D *>> &tasks,
+                        const std::vector<unsigned> &launchOrder,
+                        const std::vector<uint8_t> &bands,
+                        const unsigned mirrorAxis,
+                        const Transaction originalTransaction,
+                        std::atomic<Transaction>& transaction,
+                        Fn &&func, Args &&... args)
+    {
+        outTiles.clear();
+        outTiles.reserve(bufferTiles.w * bufferTiles.h);
+        uint8_t * const pixels = reinterpret_cast<uint8_t*>(&framebuffer[0]);
+        for(unsigned y = 0; y < bufferTiles.h; ++y)
+        {
+            for(unsigned x = 0; x < bufferTiles.w; ++x)
+            {
+                uint8_t * const tile_corner = pixels + y * spec.h * spec.stride + x * spec.w * sizeof(PixelType);
+                outTiles.emplace(outTiles.end(), tile_corner, uint16_t(x), uint16_t(y));
+            }
+        }
+        auto mirrored = [&](const unsigned tileY) {
+            const unsigned firstRow = tileY * spec.h;
+            return mirrorAxis < 2 * firstRow && firstRow + spec.h - 1 <= mirrorAxis;
+        };
+        tasks.assign(outTiles.size(), stlab::future<Tile2D *>());
+        for(const unsigned i : launchOrder)
+        {
+            if(!mirrored(i / bufferTiles.w))
+            {
+                tasks[i] = LaunchTileBands(ex, spec, outTiles[i], bands.empty() ? 1 : bands[i], func, args...);
+            }
+        }
+        // Mirrored scanlines all come from above, in tile rows that aren't mirrored themselves and so were launched above:
+        for(unsigned y = 0; y < bufferTiles.h; ++y)
+        {
+            if(!mirrored(y))
+            {
+                continue;
+            }
+            const unsigned firstRow = y * spec.h;
+            const unsigned lastRow = firstRow + spec.h - 1;
+            for(unsigned x = 0; x < bufferTiles.w; ++x)
+            {
+                std::vector<stlab::future<Tile2D *>> sources;
+                for(unsigned sourceY = (mirrorAxis - lastRow) / spec.h; sourceY <= (mirrorAxis - firstRow) / spec.h; ++sourceY)
+                {
+                    sources.push_back(tasks[sourceY * bufferTiles.w + x]);
+                }
+                Tile2D* const tile = &outTiles[y * bufferTiles.w + x];
+                const size_t columnOffset = x * spec.w * sizeof(PixelType);
+                auto copyMirror = [spec, tile, pixels, columnOffset, firstRow, mirrorAxis, originalTransaction, &transaction]
+                        (const std::vector<Tile2D *>&) -> Tile2D *
+                {
+                    if(transaction == originalTransaction)
+                    {
+                        for(unsigned row = 0; row < spec.h; ++row)
+                        {
+                            const uint8_t* const source = pixels + (mirrorAxis - (firstRow + row)) * spec.stride + columnOffset;
+                            std::copy(source, source + spec.w * sizeof(PixelType), addressRow<uint8_t>(spec, *tile, row));
+                        }
+                    }
+                    return tile;
+                };
+                tasks[y * bufferTiles.w + x] = stlab::when_all(ex, copyMirror, std::make_pair(sources.begin(), sources.end()));
+            }
+        }
+    }
+
+    /**
+     * Like LaunchColorize, but into framebuffer tiles it has already made, so that
+     * tiles of escape counts worked on again by later tasks can be coloured again.
+     * Tiles whose count future is invalid were left as they are, and are ready at once.
+     * @param framebufferDims The dims of the framebuffer the tiles are in, which partial tiles are clipped to.
+     * @param tasks Filled with a future per tile in tiles, in the same order.
+     */
+    template<typename Executor, typename CountsSpec>
+    void
+    LaunchColorizeTiles(Executor& ex, const std::vector<stlab::future<Tile2D *>>& countTasks,
+                        const CountsSpec& countsSpec, const TileSpec& spec, std::vector<Tile2D>& tiles, const Dims2U framebufferDims,
+                        std::vector<stlab::future<Tile2D *>> &tasks,
+                        const Palette& palette, const ColorizeKernel colorize,
+                        const Transaction originalTransaction,
+                        std::atomic<Transaction>& transaction)
+    {
+        tasks.clear();
+        tasks.reserve(countTasks.size());
+        for(unsigned i = 0; i < tiles.size(); ++i)
+        {
+            Tile2D* const tile = &tiles[i];
+            if(!countTasks[i].valid())
+            {
+                tasks.push_back(stlab::make_ready_future(tile, ex));
+                continue;
+            }
+            tasks.push_back(countTasks[i].then(ex,
+                    [spec, countsSpec, tile, framebufferDims, &palette, colorize, originalTransaction, &transaction](Tile2D* const counts) -> Tile2D *
+            {
+                if(transaction == originalTransaction)
+                {
+                    colorizeTile(countsSpec, *counts, spec, *tile, framebufferDims, palette, colorize);
+                }
+                return tile;
+            }));
+        }
+    }
+
+    /**
+     * Colour each tile of a framebuffer as a continuation of the task computing its
+     * escape counts, so tiles are coloured while others are still iterating.
+     * Colouring a tile takes microseconds, so the immediate executor suits it best:
+     * on a queueing one it waits behind every tile launched after its own.
+     * @param countTasks Futures of the tiles of escape counts, in the tile order LaunchTiles uses.
+     * @param countsSpec The spec of the tiles of escape counts, possibly a FixedTileSpec.
+     * @param bufferTiles The grid of tiles, which may include partial tiles at the
+     * framebuffer's right and bottom edges (see tileGridCovering()). Those are only
+     * coloured inside the framebuffer.
+     * @param tasks Filled with futures of the tiles of framebuffer, held in outTiles.
+     */
+    template<typename Executor, typename CountsSpec>
+    void
+    LaunchColorize(Executor& ex, const std::vector<stlab::future<Tile2D *>>& countTasks,
+                   const CountsSpec& countsSpec, const TileSpec& spec, const Dims2U bufferTiles,
+                   Framebuffer& framebuffer, std::vector<Tile2D>& outTiles,
+                   std::vector<stlab::future<Tile2D *>> &tasks,
+                   const Palette& palette, const ColorizeKernel colorize,
+                   const Transaction originalTransaction,
+                   std::atomic<Transaction>& transaction)
+    {
+        outTiles.clear();
+        outTiles.reserve(bufferTiles.w * bufferTiles.h);
+        for(unsigned y = 0; y < bufferTiles.h; ++y)
+        {
+            for(unsigned x = 0; x < bufferTiles.w; ++x)
+            {
+                uint8_t * const tile_corner = reinterpret_cast<uint8_t*>(&framebuffer[0]) + y * spec.h * spec.stride + x * spec.w * sizeof(RGBA);
+                outTiles.emplace(outTiles.end(), tile_corner, uint16_t(x), uint16_t(y));
+            }
+        }
+        LaunchColorizeTiles(ex, countTasks, countsSpec, spec, outTiles, framebufferDimsOf(spec, framebuffer), tasks,
+                            palette, colorize, originalTransaction, transaction);
+    }
+
+    /**
+     * The z and count of each pixel of a tile at one precision tier, so a render
+     * with a higher maxIters can carry on from where the last one stopped.
+     * A pixel has escaped if its count is below maxIters.
+     */
+    template<typename Stored>
+    struct TileIterationState {
+        /** The maxIters the pixels were iterated to, or 0 if they haven't been. */
+        unsigned maxIters = 0;
+        /** How many pixels reached maxIters, the only ones a later render iterates. */
+        unsigned capped = 0;
+        /** How many pixels were found inside the set, whose counts are maxIters whatever it is. */
+        unsigned interior = 0;
+        std::vector<Stored> zr;
+        std::vector<Stored> zi;
+        /** Escape count, maxIters or ITERS_INTERIOR. */
+        std::vector<uint32_t> iters;
+    };
+
+    /**
+     * The iteration state of every tile of a view, kept by the caller between
+     * renders. Rendering different bounds, at a different precision, with
+     * different tiles or interior checks, or into other counts starts it again.
+     */
+    class IterationState {
+    public:
+        /** Forget the state unless it is for this view, rendered this way into counts. */
+        void prepare(const PlaneBounds& bounds, const Precision precision, const Dims2U tileDims, const Dims2U tileGridDims,
+                     const bool interiorChecks, const std::vector<uint16_t>& counts)
+        {
+            if(precision == this->precision && std::memcmp(&bounds, &this->bounds, sizeof(bounds)) == 0 &&
+               tileDims.w == this->tileDims.w && tileDims.h == this->tileDims.h &&
+               tileGridDims.w == this->tileGridDims.w && tileGridDims.h == this->tileGridDims.h &&
+               interiorChecks == this->interiorChecks && &counts[0] == this->counts)
+            {
+                return;
+            }
+            this->bounds = bounds;
+            this->precision = precision;
+            this->tileDims = tileDims;
+            this->tileGridDims = tileGridDims;
+            this->interiorChecks = interiorChecks;
+            this->counts = &counts[0];
+            tiles = Tiles();
+        }
+
+        /** The state of each tile, in the order LaunchTiles creates them. */
+        template<typename Stored>
+        std::vector<TileIterationState<Stored>>& tileStates()
+        {
+            return std::get<std::vector<TileIterationState<Stored>>>(tiles);
+        }
+
+    private:
+        using Tiles = std::tuple<std::vector<TileIterationState<float>>, std::vector<TileIterationState<double>>,
+                                 std::vector<TileIterationState<DoubleDouble>>, std::vector<TileIterationState<QuadDouble>>>;
+        PlaneBounds bounds = {};
+        Precision precision = Precision::Auto;
+        Dims2U tileDims = {0, 0};
+        Dims2U tileGridDims = {0, 0};
+        bool interiorChecks = false;
+        /** The counts the tiles were last written to, which settled tiles are left in. */
+        const uint16_t* counts = nullptr;
+        Tiles tiles;
+    };
+
+    /**
+     * Whether a tile's counts are final for any higher maxIters: all its pixels
+     * escaped, so a render carrying on from its state needn't touch it.
+     */
+    template<typename Stored>
+    bool settled(const TileIterationState<Stored>& state)
+    {
+        return state.maxIters != 0 && state.capped == 0 && state.interior == 0;
+    }
+
+    /** The value traced with a purge: how many tasks it took out of the queue. */
+    constexpr const char* PURGE_TRACE_VALUES[] = {"purged", nullptr, nullptr, nullptr};
+
+    /**
+     * A queue of tile tasks in front of stlab's default executor, from which an
+     * abandoned frame's tasks can be purged before they start. Each task is tagged
+     * with the transaction of its frame. Up to as many runs of the queue as the
+     * default executor has threads take tasks from its front until it is empty, so
+     * a purged task never takes up a worker, and leaves nothing behind on the
+     * default executor. It must outlive the frames launched on it.
+     */
+    class TileQueue {
+    public:
+        /**
+         * An executor queueing tasks on queue for the frame of transaction, or
+         * passing them straight to stlab's default executor if queue is null.
+         */
+        struct Executor {
+            TileQueue* queue;
+            Transaction transaction;
+
+            template<typename F>
+            void operator()(F&& f) const
+            {
+                if(queue)
+                {
+                    // Tasks may be move only, which std::function can't hold directly:
+                    const auto task = std::make_shared<std::decay_t<F>>(std::forward<F>(f));
+                    queue->push(transaction, [task] { (*task)(); }, nullptr);
+                }
+                else
+                {
+                    default_executor(std::forward<F>(f));
+                }
+            }
+        };
+
+        /**
+         * @param workers If not 0, at most this many of the queue's tasks run at once,
+         * as if the frame had only that many workers, for measuring how rendering
+         * scales with them. Up to the default executor's thread count.
+         */
+        explicit TileQueue(const unsigned workers = 0) : state(std::make_shared<State>())
+        {
+            state->runners = workers > 0 ? workers : std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        /** An executor for the tasks of the frame of transaction. */
+        Executor executor(const Transaction transaction) { return {this, transaction}; }
+
+        /**
+         * Queue a tile's task for the frame of transaction. If the frame is purged
+         * before the task starts, its future is resolved with tile without running it.
+         */
+        template<typename F>
+        stlab::future<Tile2D *> pushTile(const Transaction transaction, Tile2D* const tile, F&& f)
+        {
+            auto packaged = stlab::package<Tile2D *(bool)>(immediate_executor, [tile, f = std::forward<F>(f)](const bool run) mutable -> Tile2D *
+            {
+                return run ? f() : tile;
+            });
+            const auto task = std::make_shared<decltype(packaged.first)>(std::move(packaged.first));
+            push(transaction, [task] { (*task)(true); }, [task] { (*task)(false); });
+            return std::move(packaged.second);
+        }
+
+        /**
+         * Take the queued tasks of every transaction but current out of the queue.
+         * Tile tasks from pushTile() are resolved with their tiles on this thread
+         * without running, so the workers go straight on to current's tiles rather
+         * than dequeuing every stale one first. Other tasks, such as continuations
+         * whose results only stlab can produce, are run here instead, and return at
+         * once for an abandoned frame. Tasks the purged ones queue in turn, such as
+         * later progressive passes, are purged too.
+         * @return The number of tasks purged.
+         */
+        size_t purge(const Transaction current)
+        {
+            const uint64_t traceStart = traceBegin();
+            size_t purged = 0;
+            for(;;)
+            {
+                std::vector<Task> stale;
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    const auto firstStale = std::stable_partition(state->tasks.begin(), state->tasks.end(),
+                                                                  [current](const Task& task) { return task.transaction == current; });
+                    std::move(firstStale, state->tasks.end(), std::back_inserter(stale));
+                    state->tasks.erase(firstStale, state->tasks.end());
+                }
+                if(stale.empty())
+                {
+                    traceSpan("purge", traceStart, 0, 0, PURGE_TRACE_VALUES, uint32_t(purged));
+                    return purged;
+                }
+                for(Task& task : stale)
+                {
+                    if(task.drop)
+                    {
+                        task.drop();
+                    }
+                    else
+                    {
+                        task.run();
+                    }
+                }
+                purged += stale.size();
+            }
+        }
+
+        /** The number of tasks waiting to start. */
+        size_t pending() const
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            return state->tasks.size();
+        }
+
+    private:
+        struct Task {
+            Transaction transaction;
+            std::function<void()> run;
+            /** Resolves the task's future without running it, or null if only running it can. */
+            std::function<void()> drop;
+        };
+
+        struct State {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+            /** The most runs of the queue there may be at once. */
+            unsigned runners = 1;
+            /** How many runs of the queue are running or waiting for an executor thread. */
+            unsigned running = 0;
+        };
+
+        void push(const Transaction transaction, std::function<void()> run, std::function<void()> drop)
+        {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->tasks.push_back({transaction, std::move(run), std::move(drop)});
+                if(state->running == state->runners)
+                {
+                    return;
+                }
+                ++state->running;
+            }
+            // Each run of the queue takes tasks from the front until there are none left:
+            default_executor([state = state]
+            {
+                for(;;)
+                {
+                    std::function<void()> run;
+                    {
+                        std::lock_guard<std::mutex> lock(state->mutex);
+                        if(state->tasks.empty())
+                        {
+                            --state->running;
+                            return;
+                        }
+                        run = std::move(state->tasks.front().run);
+                        state->tasks.pop_front();
+                    }
+                    run();
+                }
+            });
+        }
+
+        std::shared_ptr<State> state;
+    };
+
+    /** Queue a tile's task so that purging its frame resolves it with the tile rather than running it. */
+    template<typename F>
+    stlab::future<Tile2D *> asyncTile(TileQueue::Executor& ex, Tile2D* const tile, F&& f)
+    {
+        if(!ex.queue)
+        {
+            return stlab::async(default_executor, std::forward<F>(f));
+        }
+        return ex.queue->pushTile(ex.transaction, tile, std::forward<F>(f));
+    }
+
+    /**
+     * Storage launching a frame needs, kept from one frame to the next so that
+     * launching another of the same size doesn't allocate it again. Hand the
+     * futures a frame returned back to recycle() before launching the next, so
+     * their storage is reused rather than freed. stlab allocates each task's
+     * shared state itself, which this can't pool.
+     */
+    class FrameArena {
+    public:
+        /** Empty storage for a frame's futures, with the capacity of recycled storage if there is any. */
+        std::vector<stlab::future<Tile2D *>> futures()
+        {
+            if(spares.empty())
+            {
+                return {};
+            }
+            std::vector<stlab::future<Tile2D *>> storage = std::move(spares.back());
+            spares.pop_back();
+            return storage;
+        }
+
+        /** Release futures, keeping their storage for futures() to hand out again. */
+        void recycle(std::vector<stlab::future<Tile2D *>>&& futures)
+        {
+            futures.clear();
+            if(futures.capacity() > 0)
+            {
+                spares.push_back(std::move(futures));
+            }
+        }
+
+        /** tileOrder(order, bufferTiles, focus), only worked out again when one of them changes. */
+        const std::vector<unsigned>& launchOrder(const TileOrder order, const Dims2U bufferTiles, const Point2U focus)
+        {
+            if(orderIndices.empty() || order != orderKind || bufferTiles.w != orderTiles.w || bufferTiles.h != orderTiles.h ||
+               focus.x != orderFocus.x || focus.y != orderFocus.y)
+            {
+                orderIndices = tileOrder(order, bufferTiles, focus);
+                orderKind = order;
+                orderTiles = bufferTiles;
+                orderFocus = focus;
+            }
+            return orderIndices;
+        }
+
+    private:
+        std::vector<std::vector<stlab::future<Tile2D *>>> spares;
+        std::vector<unsigned> orderIndices;
+        TileOrder orderKind = TileOrder::RowMajor;
+        Dims2U orderTiles = {0, 0};
+        Point2U orderFocus = {0, 0};
+    };
+
+    /**
+     * What each tile of a frame cost to render, as an array per measure with a value
+     * per tile in row-major order, for finding the views and tile sizes that leave
+     * workers idle while a few tiles hold the frame up. The tiles' tasks fill it in
+     * as they finish, so read it once the frame is done. Tiles taken from a
+     * TileCache or mirrored aren't iterated, and are left at 0.
+     */
+    struct TileMetrics {
+        /** Size every array for a frame of tileCount tiles, all 0. */
+        void reset(const size_t tileCount)
+        {
+            iterations = std::vector<std::atomic<uint64_t>>(tileCount);
+            capped = std::vector<std::atomic<uint32_t>>(tileCount);
+            nanoseconds = std::vector<std::atomic<uint64_t>>(tileCount);
+            threads = std::vector<std::atomic<uint32_t>>(tileCount);
+            cancelled = std::vector<std::atomic<bool>>(tileCount);
+            for(auto& counts : perfCounts)
+            {
+                counts = std::vector<std::atomic<uint64_t>>(hardwareCounters ? tileCount : 0);
+            }
+            perfCounted = 0;
+        }
+
+        size_t size() const { return nanoseconds.size(); }
+
+        /**
+         * The sum of the tile's escape counts, the iterations a render of it takes
+         * without the interior early-outs. Not counted for cancelled tiles.
+         */
+        std::vector<std::atomic<uint64_t>> iterations;
+        /** How many of the tile's pixels reached maxIters. Not counted for cancelled tiles. */
+        std::vector<std::atomic<uint32_t>> capped;
+        /** The wall time of the tile's tasks, summed over its bands or progressive passes. */
+        std::vector<std::atomic<uint64_t>> nanoseconds;
+        /** The threadNumber() of the worker that ran the tile, or its last band or pass. */
+        std::vector<std::atomic<uint32_t>> threads;
+        /** Whether the frame had been abandoned by the time the tile finished, so it may have stopped part way. */
+        std::vector<std::atomic<bool>> cancelled;
+
+        /**
+         * Whether to read the workers' hardware counters around each tile task into
+         * perfCounts. Each read is a system call, so costs a microsecond or two a task.
+         */
+        bool hardwareCounters = false;
+        /** The events counted while the tile's tasks ran, per PerfCounter. Empty without hardwareCounters. */
+        std::array<std::vector<std::atomic<uint64_t>>, PERF_COUNTERS> perfCounts;
+        /** A bit per PerfCounter some worker counted, as in PerfSample::counted. 0 if the counters couldn't be read. */
+        std::atomic<uint32_t> perfCounted{0};
+    };
+
+    /**
+     * Wrap a tile function so each call adds what it cost to metrics' values for its
+     * tile, or passes straight through to func if metrics is null. A band of a tile
+     * launched by LaunchTileBands() adds to the whole tile's values.
+     * @param tileH The height of the frame's tiles, to find which tile a band is of.
+     * @param countPixels Whether to add up the tile's escape counts after the call.
+     * False for calls that leave them unfinished, like progressive passes before the last.
+     */
+    template<typename Fn>
+    auto meteredTiles(const Fn& func, TileMetrics* const metrics, const unsigned tilesPerRow, const unsigned tileH, const bool countPixels,
+                      const unsigned maxIters, const Transaction originalTransaction, const std::atomic<Transaction>& transaction)
+    {
+        return [func, metrics, tilesPerRow, tileH, countPixels, maxIters, originalTransaction, &transaction]
+                (const auto& spec, Tile2D& tile, auto&&... args) -> Tile2D *
+        {
+            if(!metrics)
+            {
+                return func(spec, tile, args...);
+            }
+            PerfSample startCounts;
+            const bool counting = metrics->hardwareCounters && readPerfCounters(startCounts);
+            const auto startTime = std::chrono::steady_clock::now();
+            Tile2D* const done = func(spec, tile, args...);
+            const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+            const unsigned i = (tile.y * spec.h / tileH) * tilesPerRow + tile.x;
+            PerfSample endCounts;
+            if(counting && readPerfCounters(endCounts))
+            {
+                for(unsigned counter = 0; counter < PERF_COUNTERS; ++counter)
+                {
+                    metrics->perfCounts[counter][i].fetch_add(endCounts.values[counter] - startCounts.values[counter], std::memory_order_relaxed);
+                }
+                metrics->perfCounted.fetch_or(endCounts.counted, std::memory_order_relaxed);
+            }
+            metrics->nanoseconds[i].fetch_add(uint64_t(nanos), std::memory_order_relaxed);
+            metrics->threads[i].store(threadNumber(), std::memory_order_relaxed);
+            if(transaction != originalTransaction)
+            {
+                metrics->cancelled[i].store(true, std::memory_order_relaxed);
+            }
+            else if(countPixels)
+            {
+                const unsigned cap = std::min(maxIters, MAX_STORED_COUNT);
+                uint64_t iterations = 0;
+                uint32_t capped = 0;
+                for (unsigned y = 0; y < spec.h; ++y) {
+                    const uint16_t* const counts = addressRow<uint16_t>(spec, tile, y);
+                    for (unsigned x = 0; x < spec.w; ++x) {
+                        iterations += counts[x];
+                        capped += counts[x] >= cap;
+                    }
+                }
+                metrics->iterations[i].fetch_add(iterations, std::memory_order_relaxed);
+                metrics->capped[i].fetch_add(capped, std::memory_order_relaxed);
+            }
+            return done;
+        };
+    }
+
+    /**
+     * Write a picture of the time each tile of a frame took to path as a PNG the
+     * size of the frame, so it can be laid over the render. Tiles go from black
+     * through red and yellow to white as they near the slowest one's time, and
+     * cancelled tiles are blue. Partial tiles at the right and bottom edges are cut
+     * to the frame.
+     * @return The stbi_write_png() result, nonzero on success.
+     */
+    inline int writeTileHeatmap(const char* const path, const TileMetrics& metrics, const TileSpec& spec, const Dims2U framebufferDims)
+    {
+        const Dims2U tileGridDims = tileGridCovering(spec, framebufferDims);
+        uint64_t slowest = 1;
+        for(const auto& nanos : metrics.nanoseconds)
+        {
+            slowest = std::max<uint64_t>(slowest, nanos);
+        }
+        const Dims2U dims = framebufferDims;
+        std::vector<RGBA> pixels(dims.w * dims.h);
+        for(unsigned i = 0; i < metrics.size(); ++i)
+        {
+            const float t = float(metrics.nanoseconds[i]) / slowest;
+            const auto ramp = [t](const float start) { return unsigned(255.0f * std::min(std::max((t - start) * 3.0f, 0.0f), 1.0f)); };
+            const RGBA colour = metrics.cancelled[i] ? RGBA(0, 0, 255, 255) : RGBA(ramp(0.0f), ramp(1.0f / 3), ramp(2.0f / 3), 255);
+            const unsigned left = (i % tileGridDims.w) * spec.w;
+            const unsigned top = (i / tileGridDims.w) * spec.h;
+            const unsigned columns = std::min<unsigned>(spec.w, dims.w - left);
+            for (unsigned y = top; y < std::min(top + spec.h, dims.h); ++y) {
+                std::fill(&pixels[y * dims.w + left], &pixels[y * dims.w + left] + columns, colour);
+            }
+        }
+        return stbi_write_png(path, int(dims.w), int(dims.h), 4, &pixels[0], int(dims.w * sizeof(RGBA)));
+    }
+
+    /** Knobs for how mandelbrotAsyncTiled iterates pixels. */
+    struct MandelbrotOptions {
+        /** Which instruction set to iterate pixels with. */
+        KernelIsa kernelIsa = KernelIsa::Auto;
+        /**
+         * Stream each tile's pixels through the vector lanes, refilling a lane as
+         * soon as its pixel finishes, rather than iterating scanline groups in
+         * lockstep. Pays off near the set boundary where neighbouring pixels
+         * escape at very different iterations. Cancellation is then only checked
+         * before the tile starts rather than per scanline. Float precision only.
+         */
+        bool laneRefill = false;
+        /** The arithmetic to iterate pixels with. Auto picks per frame from the view's pixel spacing. */
+        Precision precision = Precision::Auto;
+        /**
+         * Skip iterating pixels that can be shown to be inside the set: those in the
+         * main cardioid or period 2 bulb, and those whose orbit settles into a cycle.
+         * Interior pixels otherwise cost the full maxIters each.
+         */
+        bool interiorChecks = true;
+        /**
+         * Fill each tile by Mariani-Silver subdivision, iterating only the borders of
+         * rectangles that turn out to have a single count inside. Takes precedence
+         * over laneRefill. Cancellation is then only checked before the tile starts.
+         */
+        bool subdivide = false;
+        /**
+         * Copy tiles that mirror others about the real axis rather than computing
+         * them, when the view's pixel grid is symmetric about the axis to within
+         * MIRROR_TOLERANCE of a pixel.
+         */
+        bool mirror = false;
+        /**
+         * If set, pixels are iterated with the resume kernels and their state kept
+         * here, so that rendering the view again with a higher maxIters only iterates
+         * the pixels that reached the last one. Tiles whose pixels all escaped
+         * aren't launched again, and keep their counts, so the counts mustn't be
+         * rendered into without the state in between. Takes precedence over
+         * subdivide and laneRefill.
+         */
+        IterationState* state = nullptr;
+        /** The order tiles are launched in. */
+        TileOrder order = TileOrder::RowMajor;
+        /** The framebuffer pixel TileOrder::Focus launches the tiles nearest first. */
+        Point2U focus = {0, 0};
+        /**
+         * If not 0, split tiles the probe TileOrder::Costliest uses rates costly into
+         * bands of scanlines launched as tasks of their own, so that no one task
+         * holds up a frame being shared between this many workers. Ignored with state.
+         */
+        unsigned splitWorkers = 0;
+        /**
+         * If set, render in PROGRESSIVE_PASSES passes, the first iterating one pixel in
+         * every PROGRESSIVE_COARSEST x PROGRESSIVE_COARSEST block and each later one the
+         * pixels halfway between those done so far, so a coarse frame can be shown
+         * almost at once. Each pass's futures, coarsest first, are put here as it is
+         * launched, each tile's a continuation of its last. Later passes of a tile
+         * aren't split. Takes precedence over mirror, subdivide and laneRefill, and is
+         * ignored with state.
+         */
+        std::vector<std::vector<stlab::future<Tile2D *>>>* passes = nullptr;
+        /**
+         * If set, tiles whose counts are held here, from an earlier frame of the same
+         * view or one within TILE_CACHE_QUANTUM of a pixel of it, aren't iterated again,
+         * and the tiles that are iterated are added. Ignored with state, mirror and
+         * passes, which don't iterate whole tiles afresh.
+         */
+        TileCache* cache = nullptr;
+        /**
+         * If set, tile tasks are queued here rather than handed straight to the default
+         * executor, so that once the frame is abandoned, purge() can resolve those that
+         * haven't started with their tiles, without running them or them waiting for
+         * a worker.
+         */
+        TileQueue* queue = nullptr;
+        /**
+         * If set, the storage frames are launched with comes from here and is kept for
+         * the next frame, so that a frame launched like the last one, and not in
+         * TileOrder::Costliest or split, allocates nothing but stlab's tasks.
+         */
+        FrameArena* arena = nullptr;
+        /**
+         * If set, it is reset for each frame and each tile's iterations, pixels at
+         * maxIters, wall time, worker and cancellation recorded in it.
+         */
+        TileMetrics* metrics = nullptr;
+    };
+
+    /** How far, in pixels, mirrored scanlines may sit from exact mirror images. */
+    constexpr double MIRROR_TOLERANCE = 0.125;
+
+    /**
+     * Find the scanline pairs of a view that mirror each other about the real axis.
+     * @return mirrorAxis such that scanline y mirrors scanline mirrorAxis - y, or -1
+     * if the pixel grid isn't symmetric or the axis is out of view.
+     */
+    inline int mirrorAxisOf(const PlaneBounds& bounds, const Dims2U framebufferDims)
+    {
+        const FrameCoords<double> coords = frameCoordsD(bounds, framebufferDims.w, framebufferDims.h);
+        // Scanline y is at top + stepY * y, so its mirror is at y' = -2 top / stepY - y:
+        const double axis = -2.0 * coords.top / coords.stepY;
+        const double nearest = std::round(axis);
+        if(!(std::fabs(axis - nearest) <= MIRROR_TOLERANCE) || nearest < 1 || nearest > 2.0 * (framebufferDims.h - 1))
+        {
+            return -1;
+        }
+        return int(nearest);
+    }
+
+    /** How far, in pixels, a view may sit from a whole pixel pan of the last one for its pixels to be reused. */
+    constexpr double PAN_TOLERANCE = 0.125;
+
+    /**
+     * The view a whole number of pixels across from another: pixel (x, y) of it is
+     * pixel (x + panX, y + panY) of bounds.
+     */
+    inline PlaneBounds pannedBounds(const PlaneBounds& bounds, const Dims2U framebufferDims, const int panX, const int panY)
+    {
+        const QuadDouble dx = divide(bounds.right - bounds.left, double(framebufferDims.w)) * QuadDouble{{double(panX), 0.0, 0.0, 0.0}};
+        const QuadDouble dy = divide(bounds.bottom - bounds.top, double(framebufferDims.h)) * QuadDouble{{double(panY), 0.0, 0.0, 0.0}};
+        return {bounds.left + dx, bounds.right + dx, bounds.top + dy, bounds.bottom + dy};
+    }
+
+    /**
+     * The plane a grid of whole tiles spans, which runs on past the right and
+     * bottom edges of a framebuffer with partial tiles at a pixel spacing the same
+     * as the framebuffer's.
+     */
+    inline PlaneBounds gridBounds(const PlaneBounds& bounds, const Dims2U framebufferDims, const Dims2U gridPixels)
+    {
+        if(gridPixels.w == framebufferDims.w && gridPixels.h == framebufferDims.h)
+        {
+            return bounds;
+        }
+        const QuadDouble right = bounds.left + divide(bounds.right - bounds.left, double(framebufferDims.w)) * QuadDouble{{double(gridPixels.w), 0.0, 0.0, 0.0}};
+        const QuadDouble bottom = bounds.top + divide(bounds.bottom - bounds.top, double(framebufferDims.h)) * QuadDouble{{double(gridPixels.h), 0.0, 0.0, 0.0}};
+        return {bounds.left, right, bounds.top, bottom};
+    }
+
+    /**
+     * Find how far a view is panned from a previous one.
+     * @return false unless both have the same pixel spacing to within PAN_TOLERANCE
+     * of a pixel across the frame and bounds is a whole number of pixels from
+     * previous, to within PAN_TOLERANCE of one, and overlaps it.
+     */
+    inline bool panOffset(const PlaneBounds& previous, const PlaneBounds& bounds, const Dims2U framebufferDims, int& outPanX, int& outPanY)
+    {
+        const double stepX = (previous.right - previous.left).x[0] / framebufferDims.w;
+        const double stepY = (previous.bottom - previous.top).x[0] / framebufferDims.h;
+        if(!(std::fabs(((bounds.right - bounds.left) - (previous.right - previous.left)).x[0] / stepX) <= PAN_TOLERANCE) ||
+           !(std::fabs(((bounds.bottom - bounds.top) - (previous.bottom - previous.top)).x[0] / stepY) <= PAN_TOLERANCE))
+        {
+            return false;
+        }
+        const double panX = (bounds.left - previous.left).x[0] / stepX;
+        const double panY = (bounds.top - previous.top).x[0] / stepY;
+        if(!(std::fabs(panX - std::round(panX)) <= PAN_TOLERANCE) || !(std::fabs(panY - std::round(panY)) <= PAN_TOLERANCE) ||
+           std::fabs(panX) >= framebufferDims.w || std::fabs(panY) >= framebufferDims.h)
+        {
+            return false;
+        }
+        outPanX = int(std::round(panX));
+        outPanY = int(std::round(panY));
+        return true;
+    }
+
+    /**
+     * Move the pixels of a buffer so pixel (x, y) holds what pixel (x + panX, y + panY)
+     * did. Pixels with nothing panned into them are left as they were.
+     */
+    template<typename PixelType>
+    void shiftPixels(std::vector<PixelType>& pixels, const Dims2U dims, const int panX, const int panY)
+    {
+        const unsigned width = dims.w - unsigned(std::abs(panX));
+        const unsigned rows = dims.h - unsigned(std::abs(panY));
+        const unsigned toX = panX < 0 ? unsigned(-panX) : 0;
+        const unsigned fromX = panX > 0 ? unsigned(panX) : 0;
+        for(unsigned row = 0; row < rows; ++row)
+        {
+            // Rows move towards the side pixels leave by, so go from that side to read each before it's overwritten:
+            const unsigned toY = panY > 0 ? row : dims.h - 1 - row;
+            const unsigned fromY = unsigned(int(toY) + panY);
+            std::memmove(&pixels[toY * dims.w + toX], &pixels[fromY * dims.w + fromX], width * sizeof(PixelType));
+        }
+    }
+
+    /** A range of framebuffer columns or scanlines, from begin up to but not including end. */
+    struct PixelSpan {
+        unsigned begin;
+        unsigned end;
+    };
+
+    /**
+     * Iterate a whole tile with a lane-refilling kernel, if one was requested.
+     * Only the float tier has them.
+     * @return false if the tile should be iterated by scanline instead.
+     */
+    inline bool iterateTileLaneRefill(const FrameCoords<float>& coords, const TileKernelF laneRefill,
+                                      const Point2U framebufferPosition, const TileSpec& spec,
+                                      const unsigned maxIters, uint32_t* const outIters, InteriorCounts* const interior)
+    {
+        if(laneRefill == nullptr)
+        {
+            return false;
+        }
+        laneRefill(coords.left, coords.stepX, framebufferPosition.x, coords.top, coords.stepY, framebufferPosition.y,
+                   spec.w, spec.h, maxIters, outIters, spec.w, interior);
+        return true;
+    }
+
+    template<typename Scalar>
+    bool iterateTileLaneRefill(const FrameCoords<Scalar>&, TileKernelF, Point2U, const TileSpec&, unsigned, uint32_t*, InteriorCounts*)
+    {
+        return false;
+    }
+
+    /**
+     * Mariani-Silver subdivision of a tile: iterate only the border of a rectangle
+     * and, if every border pixel has the same count, give the whole rectangle that
+     * count; otherwise split it across its longer side and repeat on each half,
+     * down to rectangles thin enough to just iterate. The set, and each band
+     * between escape-time contours, has no holes for a uniform border to hide, so
+     * large uniform regions cost their perimeter rather than their area.
+     */
+    template<typename Coords, typename Kernel>
+    class TileSubdivision {
+    public:
+        /**
+         * @param iters Receives the count of tile pixel (x, y) at iters[y * spec.w + x].
+         */
+        TileSubdivision(const Coords& coords, const Kernel rowKernel, const Kernel columnKernel,
+                        const TileSpec& spec, const Point2U framebufferPosition,
+                        const unsigned maxIters, InteriorCounts* const interior, uint32_t* const iters) :
+                coords(coords), rowKernel(rowKernel), columnKernel(columnKernel),
+                position(framebufferPosition), w(spec.w), h(spec.h), maxIters(maxIters), interior(interior),
+                iters(iters), column(spec.h) {}
+
+        /** @return The number of pixels filled in without being iterated. */
+        unsigned run()
+        {
+            if(w < 3 || h < 3)
+            {
+                for (unsigned y = 0; y < h; ++y) {
+                    iterateRow(0, y, w);
+                }
+                return 0;
+            }
+            iterateRow(0, 0, w);
+            iterateRow(0, h - 1, w);
+            iterateColumn(0, 1, h - 2);
+            iterateColumn(w - 1, 1, h - 2);
+            subdivide(0, 0, w - 1, h - 1);
+            return filled;
+        }
+
+    private:
+        /** Rectangles whose inside is thinner than this are iterated rather than split. */
+        static constexpr unsigned MIN_SPLIT = 4;
+
+        void iterateRow(const unsigned x, const unsigned y, const unsigned count)
+        {
+            rowKernel(coords.left, coords.stepX, position.x + x, coords.top, coords.stepY, position.y + y,
+                      count, maxIters, &iters[y * w + x], interior);
+        }
+
+        void iterateColumn(const unsigned x, const unsigned y, const unsigned count)
+        {
+            columnKernel(coords.left, coords.stepX, position.x + x, coords.top, coords.stepY, position.y + y,
+                         count, maxIters, &column[0], interior);
+            for (unsigned i = 0; i < count; ++i) {
+                iters[(y + i) * w + x] = column[i];
+            }
+        }
+
+        /** Fill the inside of the rectangle with corners (x0, y0) and (x1, y1), whose border is known. */
+        void subdivide(const unsigned x0, const unsigned y0, const unsigned x1, const unsigned y1)
+        {
+            if(x1 - x0 < 2 || y1 - y0 < 2)
+            {
+                return;
+            }
+            const uint32_t first = iters[y0 * w + x0];
+            bool uniform = true;
+            for (unsigned x = x0; x <= x1 && uniform; ++x) {
+                uniform = iters[y0 * w + x] == first && iters[y1 * w + x] == first;
+            }
+            for (unsigned y = y0 + 1; y < y1 && uniform; ++y) {
+                uniform = iters[y * w + x0] == first && iters[y * w + x1] == first;
+            }
+            if(uniform)
+            {
+                for (unsigned y = y0 + 1; y < y1; ++y) {
+                    std::fill(&iters[y * w + x0 + 1], &iters[y * w + x1], first);
+                }
+                filled += (x1 - x0 - 1) * (y1 - y0 - 1);
+                return;
+            }
+            if(x1 - x0 - 1 < MIN_SPLIT || y1 - y0 - 1 < MIN_SPLIT)
+            {
+                for (unsigned y = y0 + 1; y < y1; ++y) {
+                    iterateRow(x0 + 1, y, x1 - x0 - 1);
+                }
+                return;
+            }
+            if(x1 - x0 >= y1 - y0)
+            {
+                const unsigned xm = (x0 + x1) / 2;
+                iterateColumn(xm, y0 + 1, y1 - y0 - 1);
+                subdivide(x0, y0, xm, y1);
+                subdivide(xm, y0, x1, y1);
+            }
+            else
+            {
+                const unsigned ym = (y0 + y1) / 2;
+                iterateRow(x0 + 1, ym, x1 - x0 - 1);
+                subdivide(x0, y0, x1, ym);
+                subdivide(x0, ym, x1, y1);
+            }
+        }
+
+        const Coords& coords;
+        const Kernel rowKernel;
+        const Kernel columnKernel;
+        const Point2U position;
+        const unsigned w;
+        const unsigned h;
+        const unsigned maxIters;
+        InteriorCounts* const interior;
+        uint32_t* const iters;
+        /** Scratch for column runs, which the kernels write contiguously. */
+        std::vector<uint32_t> column;
+        unsigned filled = 0;
+    };
+
+    /** Scanlines are checked for cancellation at least every this many pixel iterations. */
+    constexpr unsigned CANCEL_CHECK_ITERATIONS = 1u << 16;
+
+    /** Runs of a scanline between cancellation checks are a multiple of this, a whole number of vectors for every kernel. */
+    constexpr unsigned CANCEL_RUN_PIXELS = 16;
+
+    /**
+     * Iterate count pixels of scanline y from x0 with rowKernel, in runs of about
+     * CANCEL_CHECK_ITERATIONS / maxIters pixels, checking before each whether the
+     * frame has been abandoned. With a low maxIters a run is the whole scanline,
+     * but a deep view stops part way along a tile's first scanline.
+     * @return false if the frame was abandoned, leaving the rest of iters unset.
+     */
+    template<typename Coords, typename Kernel>
+    inline bool iterateScanline(const Coords& coords, const Kernel rowKernel, const unsigned x0, const unsigned y, const unsigned count,
+                                const unsigned maxIters, uint32_t* const iters, InteriorCounts* const interior,
+                                const Transaction originalTransaction, const std::atomic<Transaction>& transaction)
+    {
+        const unsigned run = std::max(CANCEL_RUN_PIXELS, CANCEL_CHECK_ITERATIONS / std::max(maxIters, 1u) / CANCEL_RUN_PIXELS * CANCEL_RUN_PIXELS);
+        for (unsigned x = 0; x < count; x += run) {
+            if(transaction != originalTransaction)
+            {
+                return false;
+            }
+            rowKernel(coords.left, coords.stepX, x0 + x, coords.top, coords.stepY, y, std::min(run, count - x), maxIters, iters + x, interior);
+        }
+        return true;
+    }
+
+    // Names of the values traced with each tile: the pixels that took each interior
+    // early-out, then one particular to the tile function:
+    constexpr const char* TILE_TRACE_VALUES[] = {"cardioid", "bulb", "periodic", "filled"};
+    constexpr const char* PASS_TRACE_VALUES[] = {"cardioid", "bulb", "periodic", "pass"};
+    constexpr const char* RESUME_TRACE_VALUES[] = {"cardioid", "bulb", "periodic", "resumed"};
+    constexpr const char* EXPOSED_TRACE_VALUES[] = {"cardioid", "bulb", "periodic", "exposed"};
+    constexpr const char* PERTURBED_TRACE_VALUES[] = {nullptr, nullptr, nullptr, "rebases"};
+    /** The value traced when a tile stops part way: the scanline, or column of progressive passes' columns, it stopped at. */
+    constexpr const char* CANCEL_TRACE_VALUES[] = {"at", nullptr, nullptr, nullptr};
+
+    // Define the code to run on each tile, for any precision tier. It fills a tile of escape counts:
+    auto tileMandelbrotLambda = [ ]
+           (const auto &spec,
+            Tile2D &tile,
+            const auto& coords,
+            const auto rowKernel,
+            const decltype(rowKernel) columnKernel,
+            const TileKernelF laneRefill,
+            const bool interiorChecks,
+            const unsigned maxIters,
+            const Transaction originalTransaction,
+            std::atomic<Transaction>& transaction
+           ) -> Tile2D *
+    {
+        // A tile of an abandoned frame that hadn't started, or is being purged, costs nothing:
+        if(transaction != originalTransaction)
+        {
+            traceInstant("abandoned", tile.x, tile.y);
+            return &tile;
+        }
+        const uint64_t traceStart = traceBegin();
+        const Point2U framebufferPosition = pixelPosition(spec, tile);
+        InteriorCounts interiorCounts;
+        InteriorCounts* const interior = interiorChecks ? &interiorCounts : nullptr;
+        unsigned filled = 0;
+        auto traceTile = [&]() {
+            // With the pixels that took each interior early-out:
+            traceSpan("tile", traceStart, tile.x, tile.y, TILE_TRACE_VALUES, interiorCounts.cardioid, interiorCounts.bulb, interiorCounts.periodic, filled);
+        };
+        if(columnKernel || laneRefill)
+        {
+            auto iters = tileScratch<uint32_t>(spec);
+            if(columnKernel)
+            {
+                using Subdivision = TileSubdivision<std::decay_t<decltype(coords)>, std::decay_t<decltype(rowKernel)>>;
+                filled = Subdivision(coords, rowKernel, columnKernel, spec, framebufferPosition, maxIters, interior, &iters[0]).run();
+            }
+            else
+            {
+                iterateTileLaneRefill(coords, laneRefill, framebufferPosition, spec, maxIters, &iters[0], interior);
+            }
+            for (unsigned y = 0; y < spec.h; ++y) {
+                storeCounts(&iters[y * spec.w], spec.w, addressRow<uint16_t>(spec, tile, y));
+            }
+            traceTile();
+            return &tile;
+        }
+        auto iters = rowScratch<uint32_t>(spec);
+        for (unsigned y = 0; y < spec.h; ++y) {
+            // Allow cancelation within scanlines so we don't burn cycles if this tile becomes
+            // out of date before it is even fully generated:
+            if(!iterateScanline(coords, rowKernel, framebufferPosition.x, framebufferPosition.y + y, spec.w, maxIters, &iters[0], interior,
+                                originalTransaction, transaction))
+            {
+                traceInstant("cancel", tile.x, tile.y, CANCEL_TRACE_VALUES, y);
+                break;
+            }
+            storeCounts(&iters[0], spec.w, addressRow<uint16_t>(spec, tile, y));
+        }
+        // Use this to delay tiles by a screen position dependent amount and so see them load progressively:
+        // std::this_thread::sleep_for(std::chrono::milliseconds(1*tile.x*tile.y));
+        traceTile();
+        return &tile;
+    };
+
+    /** Progressive rendering's first pass samples every PROGRESSIVE_COARSEST'th pixel each way, and each later pass halves the spacing. */
+    constexpr unsigned PROGRESSIVE_COARSEST = 4;
+
+    /** The passes of progressive rendering, the last sampling every pixel. */
+    constexpr unsigned PROGRESSIVE_PASSES = 3;
+
+    // A step scaled by a power of two, which is exact so that pixel n * factor of a
+    // frame's coords is at the same point as pixel n of the scaled ones:
+    inline float scaledStep(const float step, const unsigned factor) { return step * float(factor); }
+    inline double scaledStep(const double step, const unsigned factor) { return step * double(factor); }
+    inline DoubleDouble scaledStep(const DoubleDouble& step, const unsigned factor) { return {step.hi * factor, step.lo * factor}; }
+    inline QuadDouble scaledStep(const QuadDouble& step, const unsigned factor)
+    {
+        return {{step.x[0] * factor, step.x[1] * factor, step.x[2] * factor, step.x[3] * factor}};
+    }
+
+    // The code to run on each tile for one pass of progressive rendering, for any precision tier.
+    // Pass p iterates the pixels on a grid PROGRESSIVE_COARSEST >> p apart that earlier passes
+    // haven't, reading those they have from the tile, and fills the block of pixels below and right
+    // of each one with its count until a later pass reaches them. The last pass leaves exactly the
+    // counts tileMandelbrotLambda would have:
+    auto tileMandelbrotPassLambda = [ ]
+           (const auto &spec,
+            Tile2D &tile,
+            const auto& coords,
+            const auto rowKernel,
+            const decltype(rowKernel) columnKernel,
+            const unsigned pass,
+            const bool interiorChecks,
+            const unsigned maxIters,
+            const Transaction originalTransaction,
+            std::atomic<Transaction>& transaction
+           ) -> Tile2D *
+    {
+        if(transaction != originalTransaction)
+        {
+            traceInstant("abandoned", tile.x, tile.y);
+            return &tile;
+        }
+        const uint64_t traceStart = traceBegin();
+        const Point2U framebufferPosition = pixelPosition(spec, tile);
+        InteriorCounts interiorCounts;
+        InteriorCounts* const interior = interiorChecks ? &interiorCounts : nullptr;
+        const unsigned step = PROGRESSIVE_COARSEST >> pass;
+        const unsigned lastStep = step * 2;
+        auto iters = rowScratch<uint32_t>(spec);
+        auto rowCoords = coords;
+        rowCoords.stepX = scaledStep(coords.stepX, step);
+        // Rows the last pass didn't sample at all:
+        for (unsigned y = 0; y < spec.h; y += step) {
+            if(pass > 0 && y % lastStep == 0)
+            {
+                continue;
+            }
+            if(!iterateScanline(rowCoords, rowKernel, framebufferPosition.x / step, framebufferPosition.y + y, spec.w / step, maxIters, &iters[0], interior,
+                                originalTransaction, transaction))
+            {
+                traceInstant("cancel", tile.x, tile.y, CANCEL_TRACE_VALUES, y);
+                return &tile;
+            }
+            uint16_t* const countRow = addressRow<uint16_t>(spec, tile, y);
+            for (unsigned k = 0; k < spec.w / step; ++k) {
+                countRow[k * step] = uint16_t(std::min(iters[k], MAX_STORED_COUNT));
+            }
+        }
+        // The new columns of the rows it did, down each column:
+        if(pass > 0)
+        {
+            auto columnIters = columnScratch<uint32_t>(spec);
+            for (unsigned x = step; x < spec.w; x += lastStep) {
+                if(transaction != originalTransaction)
+                {
+                    traceInstant("cancel", tile.x, tile.y, CANCEL_TRACE_VALUES, x);
+                    return &tile;
+                }
+                columnKernel(coords.left, coords.stepX, framebufferPosition.x + x, coords.top, scaledStep(coords.stepY, lastStep), framebufferPosition.y / lastStep,
+                             spec.h / lastStep, maxIters, &columnIters[0], interior);
+                for (unsigned k = 0; k < spec.h / lastStep; ++k) {
+                    addressRow<uint16_t>(spec, tile, k * lastStep)[x] = uint16_t(std::min(columnIters[k], MAX_STORED_COUNT));
+                }
+            }
+        }
+        // Stand each sample in for the pixels the next passes will fill in:
+        if(step > 1)
+        {
+            for (unsigned y = 0; y < spec.h; y += step) {
+                const uint16_t* const sampleRow = addressRow<uint16_t>(spec, tile, y);
+                for (unsigned row = 0; row < step; ++row) {
+                    uint16_t* const countRow = addressRow<uint16_t>(spec, tile, y + row);
+                    for (unsigned x = 0; x < spec.w; x += step) {
+                        std::fill(countRow + x + (row == 0 ? 1 : 0), countRow + x + step, sampleRow[x]);
+                    }
+                }
+            }
+        }
+        traceSpan("pass", traceStart, tile.x, tile.y, PASS_TRACE_VALUES, interiorCounts.cardioid, interiorCounts.bulb, interiorCounts.periodic, pass);
+        return &tile;
+    };
+
+    // The code to run on each tile when iteration state is kept. It fills a tile of escape counts,
+    // iterating only pixels that reached the maxIters of the last render of the tile:
+    auto tileMandelbrotResumeLambda = [ ]
+           (const auto &spec,
+            Tile2D &tile,
+            const auto& coords,
+            const auto resumeKernel,
+            auto* const tileStates,
+            const unsigned tileGridWidth,
+            const bool interiorChecks,
+            const unsigned maxIters,
+            const Transaction originalTransaction,
+            std::atomic<Transaction>& transaction
+           ) -> Tile2D *
+    {
+        if(transaction != originalTransaction)
+        {
+            traceInstant("abandoned", tile.x, tile.y);
+            return &tile;
+        }
+        const uint64_t traceStart = traceBegin();
+        const Point2U framebufferPosition = pixelPosition(spec, tile);
+        InteriorCounts interiorCounts;
+        InteriorCounts* const interior = interiorChecks ? &interiorCounts : nullptr;
+        auto& state = (*tileStates)[tile.y * tileGridWidth + tile.x];
+        const unsigned numPixels = spec.w * spec.h;
+        if(state.maxIters == 0 || maxIters < state.maxIters || state.iters.size() != numPixels)
+        {
+            state.zr.assign(numPixels, {});
+            state.zi.assign(numPixels, {});
+            state.iters.assign(numPixels, 0);
+            state.maxIters = 0;
+            state.capped = numPixels;
+            state.interior = 0;
+        }
+        const unsigned resumed = maxIters > state.maxIters ? state.capped : 0;
+        if(resumed > 0)
+        {
+            const unsigned fromIters = state.maxIters;
+            // A tile cancelled part way through has pixels at both counts, so must start again:
+            state.maxIters = 0;
+            // Resumed pixels cost up to maxIters - fromIters each, so runs between cancellation checks are as in iterateScanline():
+            const unsigned run = std::max(CANCEL_RUN_PIXELS, CANCEL_CHECK_ITERATIONS / (maxIters - fromIters) / CANCEL_RUN_PIXELS * CANCEL_RUN_PIXELS);
+            for (unsigned y = 0; y < spec.h; ++y) {
+                const uint32_t* const rowIters = &state.iters[y * spec.w];
+                unsigned first = 0;
+                unsigned last = spec.w;
+                for (; first < spec.w && rowIters[first] != fromIters; ++first) {}
+                for (; last > first && rowIters[last - 1] != fromIters; --last) {}
+                for (unsigned x = first; x < last; x += run) {
+                    if(transaction != originalTransaction)
+                    {
+                        traceInstant("cancel", tile.x, tile.y, CANCEL_TRACE_VALUES, y);
+                        return &tile;
+                    }
+                    const unsigned offset = y * spec.w + x;
+                    resumeKernel(coords.left, coords.stepX, framebufferPosition.x + x, coords.top, coords.stepY, framebufferPosition.y + y,
+                                 std::min(run, last - x), fromIters, maxIters, &state.zr[offset], &state.zi[offset], &state.iters[offset], interior);
+                }
+            }
+            state.maxIters = maxIters;
+            state.capped = unsigned(std::count(state.iters.begin(), state.iters.end(), maxIters));
+            state.interior = unsigned(std::count(state.iters.begin(), state.iters.end(), ITERS_INTERIOR));
+        }
+        for (unsigned y = 0; y < spec.h; ++y) {
+            uint16_t *const countRow = addressRow<uint16_t>(spec, tile, y);
+            for (unsigned x = 0; x < spec.w; ++x) {
+                countRow[x] = uint16_t(std::min({state.iters[y * spec.w + x], uint32_t(maxIters), MAX_STORED_COUNT}));
+            }
+        }
+        traceSpan("resume", traceStart, tile.x, tile.y, RESUME_TRACE_VALUES, interiorCounts.cardioid, interiorCounts.bulb, interiorCounts.periodic, resumed);
+        return &tile;
+    };
+
+    /**
+     * The precision tier a frame will be iterated with.
+     */
+    inline Precision framePrecision(const PlaneBounds& bounds, const Dims2U framebufferDims, const unsigned maxIters, const MandelbrotOptions& options)
+    {
+        if(options.precision != Precision::Auto)
+        {
+            return options.precision;
+        }
+        return selectPrecision(bounds, framebufferDims.w, framebufferDims.h, maxIters);
+    }
+
+    /**
+     * Draw a mandelbrot set, making each tile of the image its own async task.
+     * The pixels are iterated with the cheapest arithmetic that resolves them,
+     * from float for the whole set down to quad-double for views about 1e-50 wide.
+     * Each tile's escape counts go to iterations and a continuation colours them
+     * into framebuffer through palette, so the frame can be recoloured later.
+     * With options.state, tiles whose pixels all escaped last time the view was
+     * rendered aren't iterated again. TileOrder::Costliest and options.splitWorkers
+     * iterate their probe before returning.
+     * With options.passes, the frame is rendered coarse to fine and the futures
+     * returned are those of the finest pass.
+     * The framebuffer needn't be a whole number of tiles across or down, so long
+     * as tileGridDims covers it (see tileGridCovering()).
+     **/
+    std::vector <stlab::future<Tile2D *>> mandelbrotAsyncTiled(
+            const PlaneBounds& bounds,
+            const unsigned maxIters,
+            const Transaction originalTransaction,
+            /// When this no longer matches originalTransaction, the async operations will be abandoned.
+            std::atomic<Transaction>& transaction,
+            const Dims2U tileGridDims, const TileSpec &spec, std::vector <Tile2D>& tiles, Framebuffer &framebuffer,
+            IterationFrame& iterations, const Palette& palette,
+            const MandelbrotOptions& options = MandelbrotOptions())
+    {
+        const Dims2U framebufferDims = framebufferDimsOf(spec, framebuffer);
+        const MandelbrotKernels* const kernels = &mandelbrotKernels(options.kernelIsa);
+        const unsigned w = framebufferDims.w;
+        const unsigned h = framebufferDims.h;
+
+        const int mirrorAxis = options.mirror ? mirrorAxisOf(bounds, framebufferDims) : -1;
+        const Precision precision = framePrecision(bounds, framebufferDims, maxIters, options);
+        // Resumed tiles keep their state per whole tile, so can't be split:
+        const bool split = options.splitWorkers > 0 && !options.state;
+        std::vector<uint64_t> costs;
+        if(options.order == TileOrder::Costliest || split)
+        {
+            // The probe's samples are a framebuffer over the grid's bounds with PROBE_SAMPLES pixels per tile each way:
+            const PlaneBounds probeBounds = gridBounds(bounds, framebufferDims, pixelDims(spec, tileGridDims));
+            const unsigned probeW = tileGridDims.w * PROBE_SAMPLES;
+            const unsigned probeH = tileGridDims.h * PROBE_SAMPLES;
+            switch(precision)
+            {
+                case Precision::Double:
+                    costs = probeTileCosts(frameCoordsD(probeBounds, probeW, probeH), kernels->rowD, tileGridDims, maxIters);
+                    break;
+                case Precision::DoubleDouble:
+                    costs = probeTileCosts(frameCoordsDD(probeBounds, probeW, probeH), kernels->rowDD, tileGridDims, maxIters);
+                    break;
+                case Precision::QuadDouble:
+                    costs = probeTileCosts(frameCoordsQD(probeBounds, probeW, probeH), kernels->rowQD, tileGridDims, maxIters);
+                    break;
+                default:
+                    costs = probeTileCosts(frameCoordsF(probeBounds, probeW, probeH), kernels->rowF, tileGridDims, maxIters);
+                    break;
+            }
+        }
+        FrameArena frameArena;
+        FrameArena& arena = options.arena ? *options.arena : frameArena;
+        const std::vector<unsigned> costOrder = options.order == TileOrder::Costliest ? costliestFirst(costs) : std::vector<unsigned>();
+        const std::vector<unsigned>& launchOrder = options.order == TileOrder::Costliest ? costOrder :
+                arena.launchOrder(options.order, tileGridDims, {options.focus.x / spec.w, options.focus.y / spec.h});
+        const std::vector<uint8_t> bands = split ? tileBands(costs, options.splitWorkers, spec.h) : std::vector<uint8_t>();
+        const std::shared_ptr<const FrameTileCache> cache = options.cache && !options.state && mirrorAxis < 0 ?
+                std::make_shared<const FrameTileCache>(*options.cache, bounds, framebufferDims, maxIters, precision, options.subdivide,
+                                                       options.interiorChecks, originalTransaction, transaction) :
+                nullptr;
+        // Queue tiles where options.queue can purge them once the frame is abandoned, if it is set:
+        TileQueue::Executor tileExecutor = {options.queue, originalTransaction};
+        if(options.metrics)
+        {
+            options.metrics->reset(tileGridDims.w * tileGridDims.h);
+        }
+        auto metered = [&](const auto& func, const bool countPixels)
+        {
+            return meteredTiles(func, options.metrics, tileGridDims.w, spec.h, countPixels, maxIters, originalTransaction, transaction);
+        };
+        // Launch func on each tile of escape counts of order, with the tile dims as compile time constants if
+        // they are a common size, then colour the tiles as they finish. The rest of launchOrder are ready as they are:
+        auto launchSome = [&](const std::vector<unsigned>& order, auto& func, const auto&... args)
+        {
+            return withFixedTileSpec(iterations.spec, [&](const auto& countsSpec)
+            {
+                std::vector<stlab::future<Tile2D *>> counts = arena.futures();
+                if(mirrorAxis >= 0)
+                {
+                    LaunchTilesMirrored(tileExecutor, countsSpec, tileGridDims, iterations.counts, iterations.tiles, counts, order, bands, unsigned(mirrorAxis),
+                                        originalTransaction, transaction,
+                                        metered(func, true), args..., options.interiorChecks, maxIters, originalTransaction, std::ref(transaction));
+                }
+                else
+                {
+                    LaunchTiles(tileExecutor, countsSpec, tileGridDims, iterations.counts, iterations.tiles, counts, order, bands, cache,
+                                metered(func, true), args..., options.interiorChecks, maxIters, originalTransaction, std::ref(transaction));
+                }
+                if(&order != &launchOrder)
+                {
+                    for(const unsigned i : launchOrder)
+                    {
+                        if(!counts[i].valid())
+                        {
+                            counts[i] = stlab::make_ready_future(&iterations.tiles[i], immediate_executor);
+                        }
+                    }
+                }
+                std::vector<stlab::future<Tile2D *>> colored = arena.futures();
+                LaunchColorize(immediate_executor, counts, countsSpec, spec, tileGridDims, framebuffer, tiles, colored,
+                               palette, kernels->colorize, originalTransaction, transaction);
+                // The colouring continuations hold on to what they need of the counts:
+                arena.recycle(std::move(counts));
+                return colored;
+            });
+        };
+        auto launch = [&](auto& func, const auto&... args)
+        {
+            return launchSome(launchOrder, func, args...);
+        };
+        // Launch the passes of progressive rendering, each tile's one after another, returning the last:
+        auto launchProgressive = [&](const auto& coords, const auto rowKernel, const decltype(rowKernel) columnKernel)
+        {
+            return withFixedTileSpec(iterations.spec, [&](const auto& countsSpec)
+            {
+                std::vector<std::vector<stlab::future<Tile2D *>>>& passes = *options.passes;
+                for(auto& pass : passes)
+                {
+                    arena.recycle(std::move(pass));
+                }
+                passes.clear();
+                std::vector<stlab::future<Tile2D *>> counts = arena.futures();
+                LaunchTiles(tileExecutor, countsSpec, tileGridDims, iterations.counts, iterations.tiles, counts, launchOrder, bands, nullptr,
+                            metered(tileMandelbrotPassLambda, false), coords, rowKernel, columnKernel, 0u, options.interiorChecks, maxIters, originalTransaction, std::ref(transaction));
+                passes.push_back(arena.futures());
+                LaunchColorize(immediate_executor, counts, countsSpec, spec, tileGridDims, framebuffer, tiles, passes.back(),
+                               palette, kernels->colorize, originalTransaction, transaction);
+                for(unsigned pass = 1; pass < PROGRESSIVE_PASSES; ++pass)
+                {
+                    arena.recycle(std::move(counts));
+                    counts = arena.futures();
+                    LaunchTilesAfterEach(tileExecutor, passes.back(), countsSpec, iterations.tiles, counts,
+                                         metered(tileMandelbrotPassLambda, pass + 1 == PROGRESSIVE_PASSES), coords, rowKernel, columnKernel, pass, options.interiorChecks, maxIters, originalTransaction, std::ref(transaction));
+                    passes.push_back(arena.futures());
+                    LaunchColorizeTiles(immediate_executor, counts, countsSpec, spec, tiles, framebufferDims, passes.back(),
+                                        palette, kernels->colorize, originalTransaction, transaction);
+                }
+                arena.recycle(std::move(counts));
+                return passes.back();
+            });
+        };
+        auto launchResumable = [&](const auto& coords, const auto resumeKernel)
+        {
+            auto& tileStates = options.state->tileStates<std::decay_t<decltype(coords.left)>>();
+            tileStates.resize(tileGridDims.w * tileGridDims.h);
+            // Settled tiles' counts are already in place, so they're only coloured again. Mirrored tiles are
+            // copied from their sources as they finish, so every source must be launched:
+            std::vector<unsigned> unsettled;
+            if(mirrorAxis < 0)
+            {
+                unsettled.reserve(launchOrder.size());
+                for(const unsigned i : launchOrder)
+                {
+                    if(!settled(tileStates[i]))
+                    {
+                        unsettled.push_back(i);
+                    }
+                }
+            }
+            return launchSome(mirrorAxis < 0 ? unsettled : launchOrder, tileMandelbrotResumeLambda, coords, resumeKernel, &tileStates, tileGridDims.w);
+        };
+
+        if(options.state)
+        {
+            options.state->prepare(bounds, precision, {spec.w, spec.h}, tileGridDims, options.interiorChecks, iterations.counts);
+            switch(precision)
+            {
+                case Precision::Double:
+                    return launchResumable(frameCoordsD(bounds, w, h), kernels->resumeD);
+                case Precision::DoubleDouble:
+                    return launchResumable(frameCoordsDD(bounds, w, h), kernels->resumeDD);
+                case Precision::QuadDouble:
+                    return launchResumable(frameCoordsQD(bounds, w, h), kernels->resumeQD);
+                default:
+                    return launchResumable(frameCoordsF(bounds, w, h), kernels->resumeF);
+            }
+        }
+
+        if(options.passes)
+        {
+            switch(precision)
+            {
+                case Precision::Double:
+                    return launchProgressive(frameCoordsD(bounds, w, h), kernels->rowD, kernels->columnD);
+                case Precision::DoubleDouble:
+                    return launchProgressive(frameCoordsDD(bounds, w, h), kernels->rowDD, kernels->columnDD);
+                case Precision::QuadDouble:
+                    return launchProgressive(frameCoordsQD(bounds, w, h), kernels->rowQD, kernels->columnQD);
+                default:
+                    return launchProgressive(frameCoordsF(bounds, w, h), kernels->rowF, kernels->columnF);
+            }
+        }
+
+        switch(precision)
+        {
+            case Precision::Double:
+                return launch(tileMandelbrotLambda, frameCoordsD(bounds, w, h), kernels->rowD, options.subdivide ? kernels->columnD : ColumnKernelD(nullptr), TileKernelF(nullptr));
+            case Precision::DoubleDouble:
+                return launch(tileMandelbrotLambda, frameCoordsDD(bounds, w, h), kernels->rowDD, options.subdivide ? kernels->columnDD : ColumnKernelDD(nullptr), TileKernelF(nullptr));
+            case Precision::QuadDouble:
+                return launch(tileMandelbrotLambda, frameCoordsQD(bounds, w, h), kernels->rowQD, options.subdivide ? kernels->columnQD : ColumnKernelQD(nullptr), TileKernelF(nullptr));
+            default:
+                return launch(tileMandelbrotLambda, frameCoordsF(bounds, w, h), kernels->rowF, options.subdivide ? kernels->columnF : ColumnKernelF(nullptr),
+                              options.laneRefill && !options.subdivide ? kernels->laneRefillF : TileKernelF(nullptr));
+        }
+    }
+
+    /**
+     * Draw a mandelbrot set given float bounds, making each tile of the image its own async task.
+     **/
+    std::vector <stlab::future<Tile2D *>> mandelbrotAsyncTiled(
+            const float left, const float right, const float top, const float bottom,
+            const unsigned maxIters,
+            const Transaction originalTransaction,
+            /// When this no longer matches originalTransaction, the async operations will be abandoned.
+            std::atomic<Transaction>& transaction,
+            const Dims2U tileGridDims, const TileSpec &spec, std::vector <Tile2D>& tiles, Framebuffer &framebuffer,
+            IterationFrame& iterations, const Palette& palette,
+            const MandelbrotOptions& options = MandelbrotOptions())
+    {
+        return mandelbrotAsyncTiled(planeBounds(left, right, top, bottom), maxIters, originalTransaction, transaction,
+                                    tileGridDims, spec, tiles, framebuffer, iterations, palette, options);
+    }
+
+    // The code to run on each tile a pan exposes new pixels of, for any precision tier. It fills in
+    // the tile's escape counts in the exposed columns and scanlines, leaving the rest as panned:
+    auto tileMandelbrotExposedLambda = [ ]
+           (const auto &spec,
+            Tile2D &tile,
+            const auto& coords,
+            const auto rowKernel,
+            const PixelSpan exposedColumns,
+            const PixelSpan exposedRows,
+            const bool interiorChecks,
+            const unsigned maxIters,
+            const Transaction originalTransaction,
+            std::atomic<Transaction>& transaction
+           ) -> Tile2D *
+    {
+        if(transaction != originalTransaction)
+        {
+            traceInstant("abandoned", tile.x, tile.y);
+            return &tile;
+        }
+        const uint64_t traceStart = traceBegin();
+        const Point2U framebufferPosition = pixelPosition(spec, tile);
+        InteriorCounts interiorCounts;
+        InteriorCounts* const interior = interiorChecks ? &interiorCounts : nullptr;
+        const unsigned columnsBegin = std::max(exposedColumns.begin, framebufferPosition.x);
+        const unsigned columnsEnd = std::min(exposedColumns.end, framebufferPosition.x + spec.w);
+        unsigned iterated = 0;
+        auto iters = rowScratch<uint32_t>(spec);
+        for (unsigned y = 0; y < spec.h; ++y) {
+            const unsigned row = framebufferPosition.y + y;
+            const bool wholeRow = exposedRows.begin <= row && row < exposedRows.end;
+            const unsigned begin = wholeRow ? framebufferPosition.x : columnsBegin;
+            const unsigned end = wholeRow ? framebufferPosition.x + spec.w : columnsEnd;
+            if(begin >= end)
+            {
+                continue;
+            }
+            if(!iterateScanline(coords, rowKernel, begin, row, end - begin, maxIters, &iters[0], interior, originalTransaction, transaction))
+            {
+                traceInstant("cancel", tile.x, tile.y, CANCEL_TRACE_VALUES, y);
+                break;
+            }
+            storeCounts(&iters[0], end - begin, addressRow<uint16_t>(spec, tile, y) + (begin - framebufferPosition.x));
+            iterated += end - begin;
+        }
+        traceSpan("exposed", traceStart, tile.x, tile.y, EXPOSED_TRACE_VALUES, interiorCounts.cardioid, interiorCounts.bulb, interiorCounts.periodic, iterated);
+        return &tile;
+    };
+
+    /**
+     * Draw a mandelbrot set panned from the frame last drawn into framebuffer and
+     * iterations, of previousBounds, by moving the pixels still in view and only
+     * iterating the columns and scanlines the pan brings into view, so the cost
+     * follows the distance panned rather than the size of the frame.
+     * Moved pixels keep the counts of the previous view's pixel grid, which can
+     * differ from the new one's by rounding. Tiles with nothing new to iterate are
+     * ready at once, coloured by the move.
+     * Views that aren't a whole pixel pan of previousBounds (see panOffset()) are
+     * drawn afresh by mandelbrotAsyncTiled(), as are progressive ones. The tiles
+     * are launched in row-major order.
+     **/
+    std::vector <stlab::future<Tile2D *>> mandelbrotAsyncPanned(
+            const PlaneBounds& previousBounds,
+            const PlaneBounds& bounds,
+            const unsigned maxIters,
+            const Transaction originalTransaction,
+            /// When this no longer matches originalTransaction, the async operations will be abandoned.
+            std::atomic<Transaction>& transaction,
+            const Dims2U tileGridDims, const TileSpec &spec, std::vector <Tile2D>& tiles, Framebuffer &framebuffer,
+            IterationFrame& iterations, const Palette& palette,
+            const MandelbrotOptions& options = MandelbrotOptions())
+    {
+        const Dims2U framebufferDims = framebufferDimsOf(spec, framebuffer);
+        int panX = 0;
+        int panY = 0;
+        if(options.passes || !panOffset(previousBounds, bounds, framebufferDims, panX, panY))
+        {
+            return mandelbrotAsyncTiled(bounds, maxIters, originalTransaction, transaction, tileGridDims, spec, tiles, framebuffer,
+                                        iterations, palette, options);
+        }
+        const MandelbrotKernels* const kernels = &mandelbrotKernels(options.kernelIsa);
+        const unsigned w = framebufferDims.w;
+        const unsigned h = framebufferDims.h;
+        // The counts of partial tiles run on past the framebuffer, so the counts and pixels are moved separately:
+        const Dims2U gridPixels = pixelDims(spec, tileGridDims);
+        shiftPixels(iterations.counts, gridPixels, panX, panY);
+        shiftPixels(framebuffer, framebufferDims, panX, panY);
+
+        const PixelSpan exposedColumns = panX >= 0 ? PixelSpan{gridPixels.w - unsigned(panX), gridPixels.w} : PixelSpan{0, unsigned(-panX)};
+        const PixelSpan exposedRows = panY >= 0 ? PixelSpan{gridPixels.h - unsigned(panY), gridPixels.h} : PixelSpan{0, unsigned(-panY)};
+        // Pixels moved in from beyond the framebuffer's edge have counts already but still need colouring:
+        const PixelSpan recolorColumns = panX >= 0 ? PixelSpan{w - unsigned(panX), gridPixels.w} : exposedColumns;
+        const PixelSpan recolorRows = panY >= 0 ? PixelSpan{h - unsigned(panY), gridPixels.h} : exposedRows;
+        std::vector<unsigned> launchOrder;
+        for(unsigned y = 0; y < tileGridDims.h; ++y)
+        {
+            for(unsigned x = 0; x < tileGridDims.w; ++x)
+            {
+                const bool exposed = (recolorColumns.begin < (x + 1) * spec.w && x * spec.w < recolorColumns.end) ||
+                                     (recolorRows.begin < (y + 1) * spec.h && y * spec.h < recolorRows.end);
+                if(exposed)
+                {
+                    launchOrder.push_back(y * tileGridDims.w + x);
+                }
+            }
+        }
+        TileQueue::Executor tileExecutor = {options.queue, originalTransaction};
+        FrameArena frameArena;
+        FrameArena& arena = options.arena ? *options.arena : frameArena;
+        auto launch = [&](const auto& coords, const auto rowKernel)
+        {
+            return withFixedTileSpec(iterations.spec, [&](const auto& countsSpec)
+            {
+                // Tiles left out of launchOrder keep their panned counts, and invalid futures LaunchColorize passes over:
+                std::vector<stlab::future<Tile2D *>> counts = arena.futures();
+                LaunchTiles(tileExecutor, countsSpec, tileGridDims, iterations.counts, iterations.tiles, counts, launchOrder, std::vector<uint8_t>(), nullptr,
+                            tileMandelbrotExposedLambda, coords, rowKernel, exposedColumns, exposedRows,
+                            options.interiorChecks, maxIters, originalTransaction, std::ref(transaction));
+                std::vector<stlab::future<Tile2D *>> colored = arena.futures();
+                LaunchColorize(immediate_executor, counts, countsSpec, spec, tileGridDims, framebuffer, tiles, colored,
+                               palette, kernels->colorize, originalTransaction, transaction);
+                arena.recycle(std::move(counts));
+                return colored;
+            });
+        };
+        switch(framePrecision(bounds, framebufferDims, maxIters, options))
+        {
+            case Precision::Double:
+                return launch(frameCoordsD(bounds, w, h), kernels->rowD);
+            case Precision::DoubleDouble:
+                return launch(frameCoordsDD(bounds, w, h), kernels->rowDD);
+            case Precision::QuadDouble:
+                return launch(frameCoordsQD(bounds, w, h), kernels->rowQD);
+            default:
+                return launch(frameCoordsF(bounds, w, h), kernels->rowF);
+        }
+    }
+
+    // The code to run on each tile of escape counts of a deep zoom, once the frame's reference orbit is ready:
+    auto tileMandelbrotPerturbedLambda = [ ]
+           (const auto &spec,
+            Tile2D &tile,
+            const std::shared_ptr<const ReferenceOrbit>& orbit,
+            const double pixelSpacing,
+            const unsigned maxIters,
+            const Dims2U framebufferDims,
+            const Transaction originalTransaction,
+            std::atomic<Transaction>& transaction
+           ) -> Tile2D *
+    {
+        if(transaction != originalTransaction)
+        {
+            traceInstant("abandoned", tile.x, tile.y);
+            return &tile;
+        }
+        const uint64_t traceStart = traceBegin();
+        const Point2U framebufferPosition = pixelPosition(spec, tile);
+        unsigned rebases = 0;
+        for (unsigned y = 0; y < spec.h; ++y) {
+            if(transaction != originalTransaction)
+            {
+                traceInstant("cancel", tile.x, tile.y, CANCEL_TRACE_VALUES, y);
+                break;
+            }
+            // Offsets from the centre of the framebuffer, where the reference orbit is:
+            const double dci = (framebufferDims.h * 0.5 - (framebufferPosition.y + y)) * pixelSpacing;
+            uint16_t *const countRow = addressRow<uint16_t>(spec, tile, y);
+            for (unsigned x = 0; x < spec.w; ++x) {
+                // Deep views' pixels can each take many thousands of iterations, so check per pixel too:
+                if(transaction != originalTransaction)
+                {
+                    break;
+                }
+                const double dcr = ((framebufferPosition.x + x) - framebufferDims.w * 0.5) * pixelSpacing;
+                countRow[x] = uint16_t(std::min(iteratePerturbed(*orbit, {dcr, dci}, maxIters, rebases), MAX_STORED_COUNT));
+            }
+        }
+        traceSpan("perturbed", traceStart, tile.x, tile.y, PERTURBED_TRACE_VALUES, 0, 0, 0, rebases);
+        return &tile;
+    };
+
+    /**
+     * Draw a view too deep for float bounds using perturbation theory.
+     * The frame's reference orbit is computed once in its own task and every
+     * tile task is a continuation of it. Tiles are coloured as in mandelbrotAsyncTiled.
+     **/
+    std::vector <stlab::future<Tile2D *>> mandelbrotAsyncDeepZoom(
+            const DeepView& view,
+            const unsigned maxIters,
+            const Transaction originalTransaction,
+            /// When this no longer matches originalTransaction, the async operations will be abandoned.
+            std::atomic<Transaction>& transaction,
+            const Dims2U tileGridDims, const TileSpec &spec, std::vector <Tile2D>& tiles, Framebuffer &framebuffer,
+            IterationFrame& iterations, const Palette& palette, const ColorizeKernel colorize)
+    {
+        const Dims2U framebufferDims = framebufferDimsOf(spec, framebuffer);
+        const double pixelSpacing = view.width / framebufferDims.w;
+        const double maxDelta = 0.5 * pixelSpacing * std::hypot(double(framebufferDims.w), double(framebufferDims.h));
+
+        stlab::future<std::shared_ptr<const ReferenceOrbit>> orbit = stlab::async(default_executor, [view, maxIters, maxDelta, pixelSpacing]
+        {
+            return computeReferenceOrbit(view.centerRe, view.centerIm, maxIters, maxDelta, pixelSpacing);
+        });
+
+        return withFixedTileSpec(iterations.spec, [&](const auto& countsSpec)
+        {
+            const auto counts = LaunchTilesAfter(default_executor, orbit, countsSpec, tileGridDims, iterations.counts, iterations.tiles, tileMandelbrotPerturbedLambda,
+                                                 pixelSpacing, maxIters, framebufferDims, originalTransaction, std::ref(transaction));
+            std::vector<stlab::future<Tile2D *>> colored;
+            LaunchColorize(immediate_executor, counts, countsSpec, spec, tileGridDims, framebuffer, tiles, colored,
+                           palette, colorize, originalTransaction, transaction);
+            return colored;
+        });
+    }
+
+    /**
+     * The completion of a frame's tiles, which a thread can block on, with or
+     * without a timeout, or continue from, rather than polling each tile's future.
+     * Each tile counts itself off as a continuation of its future, so the waiting
+     * thread sleeps until the last one wakes it.
+     */
+    class FrameCompletion {
+    public:
+        explicit FrameCompletion(const std::vector<stlab::future<Tile2D *>>& tiles) :
+                FrameCompletion(tiles, immediate_executor, [](unsigned, Tile2D *) {}) {}
+
+        /**
+         * Also run each(index, tile) on ex as each tile is ready, where index is the
+         * tile's position in tiles. Each call is a continuation of its own tile's
+         * future, so costs the same however many tiles there are, and the frame is
+         * only complete once every call has returned.
+         */
+        template<typename Executor, typename Fn>
+        FrameCompletion(const std::vector<stlab::future<Tile2D *>>& tiles, Executor ex, Fn&& each) :
+                latch(std::make_shared<Latch>(unsigned(tiles.size())))
+        {
+            // Every tile shares the one function, which may keep state across them:
+            const auto shared = std::make_shared<std::decay_t<Fn>>(std::forward<Fn>(each));
+            // The continuations only live as long as their futures, so hold on to them:
+            counted.reserve(tiles.size());
+            for(unsigned i = 0; i < tiles.size(); ++i)
+            {
+                counted.push_back(tiles[i].then(ex, [latch = latch, shared, i](Tile2D* const done) -> Tile2D *
+                {
+                    (*shared)(i, done);
+                    std::lock_guard<std::mutex> lock(latch->mutex);
+                    if(--latch->remaining == 0)
+                    {
+                        latch->allDone.notify_all();
+                    }
+                    return done;
+                }));
+            }
+            all = stlab::when_all(immediate_executor, [](const std::vector<Tile2D *>& done) { return unsigned(done.size()); },
+                                  std::make_pair(counted.begin(), counted.end()));
+        }
+
+        /** Block until every tile is ready. @return The number of tiles. */
+        unsigned wait() const
+        {
+            std::unique_lock<std::mutex> lock(latch->mutex);
+            latch->allDone.wait(lock, [this] { return latch->remaining == 0; });
+            return latch->count;
+        }
+
+        /** Block until every tile is ready or timeout has passed. @return true if every tile is ready. */
+        template<typename Rep, typename Period>
+        bool waitFor(const std::chrono::duration<Rep, Period>& timeout) const
+        {
+            std::unique_lock<std::mutex> lock(latch->mutex);
+            return latch->allDone.wait_for(lock, timeout, [this] { return latch->remaining == 0; });
+        }
+
+        /** How many tiles are ready so far. */
+        unsigned complete() const
+        {
+            std::lock_guard<std::mutex> lock(latch->mutex);
+            return latch->count - latch->remaining;
+        }
+
+        /** Run f on ex with the number of tiles once every tile is ready. */
+        template<typename Executor, typename Fn>
+        auto then(Executor ex, Fn&& f) const
+        {
+            return all.then(ex, std::forward<Fn>(f));
+        }
+
+    private:
+        struct Latch {
+            explicit Latch(const unsigned count) : count(count), remaining(count) {}
+            const unsigned count;
+            unsigned remaining;
+            std::mutex mutex;
+            std::condition_variable allDone;
+        };
+
+        std::shared_ptr<Latch> latch;
+        std::vector<stlab::future<Tile2D *>> counted;
+        stlab::future<unsigned> all;
+    };
+
+    /**
+     * Stream a frame's tiles to each(index, tile), run on ex as each one is ready
+     * rather than once the slowest is, so per tile work such as colouring, encoding
+     * or sending can start at once.
+     * @return The completion of the frame, which includes every call of each.
+     */
+    template<typename Executor, typename Fn>
+    FrameCompletion WhenEach(Executor ex, const std::vector<stlab::future<Tile2D *>>& tiles, Fn&& each)
+    {
+        return FrameCompletion(tiles, ex, std::forward<Fn>(each));
+    }
+
+    /** The most iterations a TileAutotuner calibrates with, so that deep views don't take long to tune for. */
+    constexpr unsigned AUTOTUNE_MAX_ITERS = 256;
+
+    /** How many times each candidate is rendered, the fastest counting, to ride out a slow first frame. */
+    constexpr unsigned AUTOTUNE_RENDERS = 2;
+
+    /**
+     * Picks the tile dims to render a framebuffer size with by rendering a view
+     * with each of a few candidates and keeping the fastest. Candidates whose
+     * counts and pixels wouldn't fit in half a core's level 2 cache, or that would
+     * leave fewer than 4 tiles for each hardware thread, aren't tried. Choices are
+     * kept per framebuffer size, and can be saved so that later runs don't have
+     * to calibrate again.
+     */
+    class TileAutotuner {
+    public:
+        /** A candidate's tile dims and the fastest of its calibration renders, in seconds. */
+        struct Timing {
+            Dims2U tileDims;
+            double seconds;
+        };
+
+        /** The tile dims worth trying for a framebuffer size, smallest first. */
+        static std::vector<Dims2U> candidates(const Dims2U framebufferDims)
+        {
+            static const Dims2U all[] = {{16, 16}, {32, 32}, {64, 16}, {64, 64}, {128, 32}, {128, 128}, {256, 64}};
+            const size_t cacheBytes = level2CacheBytes() / 2;
+            const unsigned threads = std::max(std::thread::hardware_concurrency(), 1u);
+            std::vector<Dims2U> fits;
+            for(const Dims2U tileDims : all)
+            {
+                const Dims2U grid = tileGridCovering(TileSpec{TileFormat::RGBA8888, uint16_t(tileDims.w), uint16_t(tileDims.h), 0}, framebufferDims);
+                const size_t workingSet = size_t(tileDims.w) * tileDims.h * (sizeof(uint16_t) + sizeof(RGBA));
+                if(workingSet <= cacheBytes && grid.w * grid.h >= 4 * threads)
+                {
+                    fits.push_back(tileDims);
+                }
+            }
+            if(fits.empty())
+            {
+                fits.push_back(all[0]);
+            }
+            return fits;
+        }
+
+        /**
+         * The tile dims to render framebuffers of framebufferDims with: those chosen
+         * before for the size, or else the fastest candidate at rendering bounds.
+         * Calibration renders with options but without the state, passes, cache,
+         * metrics, arena or queue they may point to.
+         */
+        Dims2U tileDims(const Dims2U framebufferDims, const PlaneBounds& bounds, const unsigned maxIters, const MandelbrotOptions& options)
+        {
+            const auto chosen = choices.find({framebufferDims.w, framebufferDims.h});
+            if(chosen != choices.end())
+            {
+                return chosen->second;
+            }
+            MandelbrotOptions calibrationOptions = options;
+            calibrationOptions.state = nullptr;
+            calibrationOptions.passes = nullptr;
+            calibrationOptions.cache = nullptr;
+            calibrationOptions.metrics = nullptr;
+            calibrationOptions.arena = nullptr;
+            calibrationOptions.queue = nullptr;
+            const unsigned iters = std::min(maxIters, AUTOTUNE_MAX_ITERS);
+            const Palette palette = greyPalette(iters);
+            Framebuffer framebuffer(framebufferDims.w * framebufferDims.h);
+            timings.clear();
+            for(const Dims2U candidate : candidates(framebufferDims))
+            {
+                const TileSpec spec {TileFormat::RGBA8888, uint16_t(candidate.w), uint16_t(candidate.h), unsigned(framebufferDims.w * sizeof(RGBA))};
+                const Dims2U grid = tileGridCovering(spec, framebufferDims);
+                IterationFrame iterations(spec, grid);
+                std::vector<Tile2D> tiles;
+                std::atomic<Transaction> transaction(0);
+                double fastest = std::numeric_limits<double>::infinity();
+                for(unsigned render = 0; render < AUTOTUNE_RENDERS; ++render)
+                {
+                    const auto startTime = std::chrono::steady_clock::now();
+                    FrameCompletion(mandelbrotAsyncTiled(bounds, iters, 0, transaction, grid, spec, tiles, framebuffer, iterations, palette,
+                                                         calibrationOptions)).wait();
+                    fastest = std::min(fastest, std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
+                }
+                timings.push_back({candidate, fastest});
+            }
+            const auto best = std::min_element(timings.begin(), timings.end(), [](const Timing& a, const Timing& b) { return a.seconds < b.seconds; });
+            choices[{framebufferDims.w, framebufferDims.h}] = best->tileDims;
+            return best->tileDims;
+        }
+
+        /** How long each candidate took in the last calibration, empty if the choice was already known. */
+        const std::vector<Timing>& lastCalibration() const
+        {
+            return timings;
+        }
+
+        /**
+         * Add the choices saved at path, one "<w> <h> <tile w> <tile h>" line per
+         * framebuffer size.
+         * @return False if the file couldn't be opened.
+         */
+        bool load(const char* const path)
+        {
+            std::FILE* const file = std::fopen(path, "r");
+            if(!file)
+            {
+                return false;
+            }
+            unsigned w, h, tileW, tileH;
+            while(std::fscanf(file, "%u %u %u %u", &w, &h, &tileW, &tileH) == 4)
+            {
+                if(tileW > 0 && tileH > 0 && tileW <= UINT16_MAX && tileH <= UINT16_MAX)
+                {
+                    choices[{w, h}] = {tileW, tileH};
+                }
+            }
+            std::fclose(file);
+            return true;
+        }
+
+        /** @return False if the choices couldn't all be written to path. */
+        bool save(const char* const path) const
+        {
+            std::FILE* const file = std::fopen(path, "w");
+            if(!file)
+            {
+                return false;
+            }
+            bool written = true;
+            for(const auto& choice : choices)
+            {
+                written &= std::fprintf(file, "%u %u %u %u\n", choice.first.first, choice.first.second, choice.second.w, choice.second.h) > 0;
+            }
+            return std::fclose(file) == 0 && written;
+        }
+
+    private:
+        std::map<std::pair<unsigned, unsigned>, Dims2U> choices;
+        std::vector<Timing> timings;
+    };
+
+} // async_tiled
+
+// The benchmark builds this file for its renderer, without the example's main() and allocation counting:
+#ifndef MANDELBROT_EXAMPLE_NO_MAIN
+
+/** Heap allocations made by the whole process so far, so that the example can report each frame's. */
+static std::atomic<uint64_t> heapAllocations(0);
+
+/** Heap allocations made by this thread so far, which for the main thread leaves out those of tasks running meanwhile. */
+static thread_local uint64_t threadHeapAllocations = 0;
+
+/**
+ * Count an allocation and make it with malloc, or an aligned allocation when
+ * alignment is over that of malloc, so that every form of new below pairs with
+ * the free of its delete.
+ */
+static void* countedAllocation(const std::size_t size, const std::size_t alignment) noexcept
+{
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    ++threadHeapAllocations;
+    const std::size_t bytes = size > 0 ? size : 1;
+    if(alignment <= alignof(std::max_align_t))
+    {
+        return std::malloc(bytes);
+    }
+#ifdef _MSC_VER
+    return _aligned_malloc(bytes, alignment);
+#else
+    // aligned_alloc wants a whole number of alignments:
+    return std::aligned_alloc(alignment, (bytes + alignment - 1) / alignment * alignment);
+#endif
+}
+
+/** Free what countedAllocation made with the same alignment. */
+static void countedFree(void* const memory, const std::size_t alignment) noexcept
+{
+#ifdef _MSC_VER
+    if(alignment > alignof(std::max_align_t))
+    {
+        _aligned_free(memory);
+        return;
+    }
+#else
+    (void)alignment;
+#endif
+    std::free(memory);
+}
+
+static void* countedAllocationOrThrow(const std::size_t size, const std::size_t alignment)
+{
+    if(void* const memory = countedAllocation(size, alignment))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+// Replace the whole family, so that the counts miss none and each delete frees what its new allocated:
+void* operator new(const std::size_t size) { return countedAllocationOrThrow(size, 0); }
+void* operator new[](const std::size_t size) { return countedAllocationOrThrow(size, 0); }
+void* operator new(const std::size_t size, const std::nothrow_t&) noexcept { return countedAllocation(size, 0); }
+void* operator new[](const std::size_t size, const std::nothrow_t&) noexcept { return countedAllocation(size, 0); }
+void* operator new(const std::size_t size, const std::align_val_t alignment) { return countedAllocationOrThrow(size, std::size_t(alignment)); }
+void* operator new[](const std::size_t size, const std::align_val_t alignment) { return countedAllocationOrThrow(size, std::size_t(alignment)); }
+void* operator new(const std::size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept { return countedAllocation(size, std::size_t(alignment)); }
+void* operator new[](const std::size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept { return countedAllocation(size, std::size_t(alignment)); }
+
+void operator delete(void* const memory) noexcept { countedFree(memory, 0); }
+void operator delete[](void* const memory) noexcept { countedFree(memory, 0); }
+void operator delete(void* const memory, std::size_t) noexcept { countedFree(memory, 0); }
+void operator delete[](void* const memory, std::size_t) noexcept { countedFree(memory, 0); }
+void operator delete(void* const memory, const std::nothrow_t&) noexcept { countedFree(memory, 0); }
+void operator delete[](void* const memory, const std::nothrow_t&) noexcept { countedFree(memory, 0); }
+void operator delete(void* const memory, const std::align_val_t alignment) noexcept { countedFree(memory, std::size_t(alignment)); }
+void operator delete[](void* const memory, const std::align_val_t alignment) noexcept { countedFree(memory, std::size_t(alignment)); }
+void operator delete(void* const memory, std::size_t, const std::align_val_t alignment) noexcept { countedFree(memory, std::size_t(alignment)); }
+void operator delete[](void* const memory, std::size_t, const std::align_val_t alignment) noexcept { countedFree(memory, std::size_t(alignment)); }
+void operator delete(void* const memory, const std::align_val_t alignment, const std::nothrow_t&) noexcept { countedFree(memory, std::size_t(alignment)); }
+void operator delete[](void* const memory, const std::align_val_t alignment, const std::nothrow_t&) noexcept { countedFree(memory, std::size_t(alignment)); }
+
+int main(int argc, char** argv)
+{
+    // Pick the pixel kernel with --kernel=auto|scalar|sse2|avx2|avx512 to compare throughput per tile,
+    // and --lane-refill to stream pixels through the vector lanes rather than iterating whole groups.
+    // --no-interior-checks iterates pixels inside the set all the way to --max-iters.
+    // --subdivide fills tiles by Mariani-Silver subdivision rather than iterating every pixel.
+    // --mirror copies tiles that mirror others about the real axis instead of computing them.
+    // --palette=grey|fire picks the colours escape counts are mapped to.
+    // --order=row|spiral|hilbert|focus|costliest picks the order tiles are launched in, with --focus=<x>,<y> giving the
+    // pixel focus order starts from (the centre by default).
+    // --split[=<workers>] splits tiles the probe rates costly into bands of scanlines so they can't hold up a frame
+    // being shared between that many workers (all the hardware threads by default).
+    // --progressive renders a coarse frame first and refines it in passes, reporting when each pass is done.
+    // --pan=<dx>,<dy> then renders the view dx pixels right and dy down, only iterating the pixels that come into view.
+    // --cache-mb=<n> keeps up to n MB of finished tiles and, last of all, renders the view again from them.
+    // --spin-wait waits for tiles by polling their futures, as this example used to, to compare the CPU time it takes.
+    // --rerender=<n> renders the view n more times without and then with a FrameArena, reporting the allocations each takes.
+    // --cancel-bench[=<frames>] last of all starts that many frames (100 by default), abandoning each 1 ms in, and reports
+    // how long each took to finish with and without purging its queued tiles.
+    // --heatmap reports how evenly the first frame's tiles shared the work and saves a heatmap of their times next to it.
+    // --perf-counters reads the hardware counters around each tile of the first frame, reporting IPC and misses per pixel
+    // for each worker, where perf_event_open is permitted.
+    // --trace=<path> records when each tile was enqueued, ran and was abandoned, and writes it to path as a Chrome trace.
+    // --size=<w>x<h> renders a framebuffer of that many pixels (2048x1280 by default), which needn't be a whole number of tiles.
+    // --tile=<w>x<h> renders tiles of that many pixels (32x32 by default), and --tile=auto times a few sizes on the view
+    // and keeps the fastest, remembering it for the framebuffer size in /tmp/stlab-mandelbrot-tiles.txt.
+    // --refine=<n> renders the view again with n iterations, only iterating the pixels that reached --max-iters.
+    // Neither --max-iters nor --refine may be more than 65535, the highest count the 16 bit iteration buffer holds.
+    // --view=<re>,<im>,<width> renders a view centred on a point given to any number of digits, iterated
+    // with the cheapest of float, double, double-double and quad-double that resolves it, or the one given
+    // by --precision=float|double|double-double|quad-double. --deep-zoom=<re>,<im>,<width> renders such a
+    // view using perturbation theory instead.
+    async_tiled::MandelbrotOptions options;
+    unsigned maxIters = 32;
+    unsigned refineIters = 0;
+    bool deepZoom = false;
+    bool view = false;
+    bool fire = false;
+    bool focus = false;
+    bool progressive = false;
+    int panX = 0;
+    int panY = 0;
+    unsigned cacheMegabytes = 0;
+    bool spinWait = false;
+    unsigned cancelFrames = 0;
+    unsigned rerenders = 0;
+    const char* tracePath = nullptr;
+    bool heatmap = false;
+    bool perfCounters = false;
+    async_tiled::Dims2U framebufferDims {2048, 1280};
+    async_tiled::Dims2U tileDims {32, 32};
+    bool autotune = false;
+    async_tiled::DeepView deepView;
+    // Returns the text after "--name=" if arg starts with it:
+    auto argValue = [](const char* arg, const char* prefix) -> const char* {
+        const size_t length = std::strlen(prefix);
+        return std::strncmp(arg, prefix, length) == 0 ? arg + length : nullptr;
+    };
+    // Parses "<re>,<im>,<width>":
+    auto parseView = [](const std::string& text, async_tiled::DeepView& outView) -> bool {
+        const size_t comma1 = text.find(',');
+        const size_t comma2 = text.find(',', comma1 + 1);
+        if(comma1 == std::string::npos || comma2 == std::string::npos)
+        {
+            return false;
+        }
+        outView.centerRe = text.substr(0, comma1);
+        outView.centerIm = text.substr(comma1 + 1, comma2 - comma1 - 1);
+        outView.width = std::strtod(text.c_str() + comma2 + 1, nullptr);
+        return outView.width > 0;
+    };
+    for(int arg = 1; arg < argc; ++arg)
+    {
+        const char* value = nullptr;
+        if((value = argValue(argv[arg], "--kernel=")) && async_tiled::parseKernelIsa(value, options.kernelIsa))
+        {
+            continue;
+        }
+        if(std::strcmp(argv[arg], "--lane-refill") == 0)
+        {
+            options.laneRefill = true;
+            continue;
+        }
+        if(std::strcmp(argv[arg], "--no-interior-checks") == 0)
+        {
+            options.interiorChecks = false;
+            continue;
+        }
+        if(std::strcmp(argv[arg], "--subdivide") == 0)
+        {
+            options.subdivide = true;
+            continue;
+        }
+        if(std::strcmp(argv[arg], "--mirror") == 0)
+        {
+            options.mirror = true;
+            continue;
+        }
+        if((value = argValue(argv[arg], "--palette=")) && (std::strcmp(value, "grey") == 0 || (fire = std::strcmp(value, "fire") == 0)))
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--max-iters=")) && (maxIters = unsigned(std::strtoul(value, nullptr, 10))) > 0 &&
+           maxIters <= async_tiled::MAX_ITERS)
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--size=")) && std::sscanf(value, "%ux%u", &framebufferDims.w, &framebufferDims.h) == 2 &&
+           framebufferDims.w > 0 && framebufferDims.h > 0)
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--tile=")) && std::strcmp(value, "auto") == 0)
+        {
+            autotune = true;
+            continue;
+        }
+        if((value = argValue(argv[arg], "--tile=")) && std::sscanf(value, "%ux%u", &tileDims.w, &tileDims.h) == 2 &&
+           tileDims.w > 0 && tileDims.h > 0 && tileDims.w <= UINT16_MAX && tileDims.h <= UINT16_MAX)
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--order=")))
+        {
+            const std::string order = value;
+            if(order == "row" || order == "spiral" || order == "hilbert" || order == "focus" || order == "costliest")
+            {
+                options.order = order == "spiral" ? async_tiled::TileOrder::Spiral : order == "hilbert" ? async_tiled::TileOrder::Hilbert :
+                                order == "focus" ? async_tiled::TileOrder::Focus : order == "costliest" ? async_tiled::TileOrder::Costliest :
+                                async_tiled::TileOrder::RowMajor;
+                continue;
+            }
+        }
+        if((value = argValue(argv[arg], "--focus=")) && std::sscanf(value, "%u,%u", &options.focus.x, &options.focus.y) == 2)
+        {
+            focus = true;
+            options.order = async_tiled::TileOrder::Focus;
+            continue;
+        }
+        if(std::strcmp(argv[arg], "--progressive") == 0)
+        {
+            progressive = true;
+            continue;
+        }
+        if(std::strcmp(argv[arg], "--split") == 0)
+        {
+            options.splitWorkers = std::max(std::thread::hardware_concurrency(), 1u);
+            continue;
+        }
+        if((value = argValue(argv[arg], "--split=")) && (options.splitWorkers = unsigned(std::strtoul(value, nullptr, 10))) > 0)
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--cache-mb=")) && (cacheMegabytes = unsigned(std::strtoul(value, nullptr, 10))) > 0)
+        {
+            continue;
+        }
+        if(std::strcmp(argv[arg], "--spin-wait") == 0)
+        {
+            spinWait = true;
+            continue;
+        }
+        if((value = argValue(argv[arg], "--rerender=")) && (rerenders = unsigned(std::strtoul(value, nullptr, 10))) > 0)
+        {
+            continue;
+        }
+        if(std::strcmp(argv[arg], "--perf-counters") == 0)
+        {
+            perfCounters = true;
+            continue;
+        }
+        if(std::strcmp(argv[arg], "--heatmap") == 0)
+        {
+            heatmap = true;
+            continue;
+        }
+        if((value = argValue(argv[arg], "--trace=")) && *value)
+        {
+            tracePath = value;
+            continue;
+        }
+        if(std::strcmp(argv[arg], "--cancel-bench") == 0)
+        {
+            cancelFrames = 100;
+            continue;
+        }
+        if((value = argValue(argv[arg], "--cancel-bench=")) && (cancelFrames = unsigned(std::strtoul(value, nullptr, 10))) > 0)
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--pan=")) && std::sscanf(value, "%d,%d", &panX, &panY) == 2)
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--refine=")) && (refineIters = unsigned(std::strtoul(value, nullptr, 10))) > 0 &&
+           refineIters <= async_tiled::MAX_ITERS)
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--deep-zoom=")) && (deepZoom = parseView(value, deepView)))
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--view=")) && (view = parseView(value, deepView)))
+        {
+            continue;
+        }
+        if((value = argValue(argv[arg], "--precision=")) && async_tiled::parsePrecision(value, options.precision))
+        {
+            continue;
+        }
+        std::cerr << "Usage: " << argv[0] << " [--kernel=auto|scalar|sse2|avx2|avx512] [--lane-refill] [--no-interior-checks] [--subdivide] [--mirror] [--palette=grey|fire] [--max-iters=<n<=65535>] [--refine=<n<=65535>]"
+                     " [--order=row|spiral|hilbert|focus|costliest] [--focus=<x>,<y>] [--split[=<workers>]] [--progressive] [--rerender=<n>] [--cancel-bench[=<frames>]] [--heatmap] [--perf-counters] [--trace=<path>]"
+                     " [--size=<w>x<h>] [--tile=<w>x<h>|auto]"
+                     " [--view=<re>,<im>,<width>] [--precision=auto|float|double|double-double|quad-double]"
+                     " [--deep-zoom=<re>,<im>,<width>]" << std::endl;
+        return 1;
+    }
+    async_tiled::setTracing(tracePath != nullptr);
+    if(options.kernelIsa != async_tiled::KernelIsa::Auto && !async_tiled::kernelIsaSupported(options.kernelIsa))
+    {
+        std::cerr << "Kernel \"" << async_tiled::kernelIsaName(options.kernelIsa) << "\" is not supported on this machine." << std::endl;
+    }
+    const async_tiled::MandelbrotKernels& kernels = async_tiled::mandelbrotKernels(options.kernelIsa);
+    options.kernelIsa = kernels.isa;
+    std::cerr << "Using the " << async_tiled::kernelIsaName(kernels.isa) << " kernel (" << kernels.lanesF << " float or " << kernels.lanesD << " double pixels per instruction"
+              << (options.laneRefill ? ", lane refill" : "") << ")." << std::endl;
+
+    if(!focus || options.focus.x >= framebufferDims.w || options.focus.y >= framebufferDims.h)
+    {
+        options.focus = {framebufferDims.w / 2, framebufferDims.h / 2};
+    }
+    const async_tiled::PlaneBounds bounds = view ?
+            async_tiled::planeBounds(deepView, framebufferDims.w, framebufferDims.h) :
+            async_tiled::planeBounds(-2, 1, 1.5001f, -1.4999f);
+    if(autotune)
+    {
+        async_tiled::TileAutotuner autotuner;
+        autotuner.load(OUTPUT_PATH_TILE_CHOICES);
+        tileDims = autotuner.tileDims(framebufferDims, bounds, maxIters, options);
+        for(const async_tiled::TileAutotuner::Timing& timing : autotuner.lastCalibration())
+        {
+            std::cerr << "Calibrating " << timing.tileDims.w << "x" << timing.tileDims.h << " tiles took " << timing.seconds * 1e3 << " ms." << std::endl;
+        }
+        if(!autotuner.lastCalibration().empty() && !autotuner.save(OUTPUT_PATH_TILE_CHOICES))
+        {
+            std::cerr << "Couldn't save the tile size at \"" << OUTPUT_PATH_TILE_CHOICES << "\"." << std::endl;
+        }
+    }
+    const async_tiled::TileSpec spec {
+            async_tiled::TileFormat::RGBA8888,
+            uint16_t(tileDims.w), uint16_t(tileDims.h),
+            unsigned(framebufferDims.w * sizeof(async_tiled::RGBA))
+    };
+    // Tiles at the right and bottom edges are cut short where the framebuffer isn't a whole number of them:
+    const async_tiled::Dims2U tileGridDims = async_tiled::tileGridCovering(spec, framebufferDims);
+    std::cerr << "Rendering " << framebufferDims.w << "x" << framebufferDims.h << " pixels in " << tileGridDims.w << "x" << tileGridDims.h << " tiles of "
+              << spec.w << "x" << spec.h << "." << std::endl;
+    std::vector <async_tiled::Tile2D> tiles;
+    async_tiled::Framebuffer framebuffer(framebufferDims.w * framebufferDims.h);
+    async_tiled::IterationFrame iterations(spec, tileGridDims);
+    const async_tiled::Palette palette = fire ? async_tiled::firePalette(maxIters) : async_tiled::greyPalette(maxIters);
+    std::atomic<async_tiled::Transaction> transaction(0);
+    async_tiled::IterationState iterationState;
+    if(refineIters > 0 && !deepZoom)
+    {
+        // Both renders must use the same tier for the second to carry on from the first:
+        if(options.precision == async_tiled::Precision::Auto)
+        {
+            options.precision = async_tiled::framePrecision(bounds, framebufferDims, std::max(maxIters, refineIters), options);
+        }
+        options.state = &iterationState;
+    }
+    if(!deepZoom)
+    {
+        std::cerr << "Iterating in " << async_tiled::precisionName(async_tiled::framePrecision(bounds, framebufferDims, maxIters, options))
+                  << " precision." << std::endl;
+    }
+
+    std::vector<std::vector<stlab::future<async_tiled::Tile2D *>>> passes;
+    if(progressive && !options.state)
+    {
+        options.passes = &passes;
+    }
+
+    async_tiled::TileCache tileCache(size_t(cacheMegabytes) << 20);
+    if(cacheMegabytes > 0)
+    {
+        options.cache = &tileCache;
+    }
+
+    // Later frames reuse the storage of earlier ones, handing their futures back before each launch:
+    async_tiled::FrameArena frameArena;
+    options.arena = &frameArena;
+
+    // What each tile of the first frame cost, if asked for:
+    async_tiled::TileMetrics tileMetrics;
+    tileMetrics.hardwareCounters = perfCounters;
+    if(heatmap || perfCounters)
+    {
+        options.metrics = &tileMetrics;
+    }
+
+    // Spawn background tasks to compute the Mandelbrot set over rectangular tiles of the framebuffer:
+    const auto startTime = std::chrono::steady_clock::now();
+    const std::clock_t startCpuTime = std::clock();
+    const uint64_t startAllocations = heapAllocations;
+    const uint64_t startThreadAllocations = threadHeapAllocations;
+    auto futureTiles = deepZoom ?
+            async_tiled::mandelbrotAsyncDeepZoom(deepView, maxIters, transaction, transaction, tileGridDims, spec, tiles, framebuffer,
+                                                 iterations, palette, kernels.colorize) :
+            async_tiled::mandelbrotAsyncTiled(bounds, maxIters, transaction, transaction, tileGridDims, spec, tiles, framebuffer, iterations, palette, options);
+    const uint64_t launchAllocations = threadHeapAllocations - startThreadAllocations;
+    // Report the heap allocations a frame made launching its tiles and all told, including those of its tasks and of waiting for them:
+    auto reportAllocations = [&futureTiles](const uint64_t launched, const uint64_t total) {
+        std::cerr << "Launching it made " << launched << " heap allocations and the whole frame " << total << ", "
+                  << double(total) / std::max<size_t>(futureTiles.size(), 1) << " per tile." << std::endl;
+    };
+
+    // Wait for tiles by sleeping until the last one is done, showing progress every so often:
+    auto waitForTiles = [spinWait](std::vector<stlab::future<async_tiled::Tile2D *>>& futures) -> unsigned {
+        if(spinWait)
+        {
+            // Poll each future in turn, which keeps a core busy that could be iterating tiles:
+            unsigned complete = 0;
+            for(auto& future : futures)
+            {
+                test_future:
+                assert(future.valid());
+                auto res = future.get_try();
+                if(res){
+                    ++complete;
+                } else {
+                    std::this_thread::yield();
+                    goto test_future;
+                }
+            }
+            return complete;
+        }
+        const async_tiled::FrameCompletion frame(futures);
+        while(!frame.waitFor(std::chrono::milliseconds(100)))
+        {
+            std::cerr << " <*>";
+        }
+        return frame.complete();
+    };
+    // Stream the tiles as they are ready, as a viewer showing each at once would, noting when the first one is:
+    std::atomic<long long> firstTileMicros(-1);
+    const async_tiled::FrameCompletion streamed = async_tiled::WhenEach(stlab::immediate_executor, futureTiles,
+            [&firstTileMicros, startTime](unsigned, async_tiled::Tile2D *)
+    {
+        long long unset = -1;
+        firstTileMicros.compare_exchange_strong(unset, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count());
+    });
+    // A whole coarse pass can be shown before any tile of the finer ones is done:
+    std::vector<long long> passMicros;
+    for(unsigned pass = 0; pass + 1 < passes.size(); ++pass)
+    {
+        waitForTiles(passes[pass]);
+        passMicros.push_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count());
+    }
+    // The time to the first useful pixels, the tile the viewer is looking at:
+    std::vector<stlab::future<async_tiled::Tile2D *>> focusTile = {futureTiles[(options.focus.y / spec.h) * tileGridDims.w + options.focus.x / spec.w]};
+    waitForTiles(focusTile);
+    const auto focusMicros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+    const unsigned complete = waitForTiles(futureTiles);
+
+    const auto frameMicros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+    const double frameCpuMicros = 1e6 * double(std::clock() - startCpuTime) / CLOCKS_PER_SEC;
+
+    std::cerr << std::endl << "Num complete = " << complete << " of " << futureTiles.size() << std::endl;
+    streamed.wait();
+    std::cerr << "The first tile was ready after " << firstTileMicros << " us." << std::endl;
+    std::cerr << "The tile at (" << options.focus.x << ", " << options.focus.y << ") was ready after " << focusMicros << " us." << std::endl;
+    for(unsigned pass = 0; pass < passMicros.size(); ++pass)
+    {
+        std::cerr << "Pass " << pass << " was ready after " << passMicros[pass] << " us." << std::endl;
+    }
+    std::cerr << "Frame took " << frameMicros << " us (" << (framebufferDims.w * framebufferDims.h) / std::max<double>(frameMicros, 1.0) << " Mpixels/s), "
+              << frameCpuMicros << " us of CPU time." << std::endl;
+    reportAllocations(launchAllocations, heapAllocations - startAllocations);
+
+    // Summarize the tiles' costs: a slowest tile far above the mean holds the frame up while workers sit idle:
+    if(options.metrics && !deepZoom)
+    {
+        uint64_t totalNanos = 0;
+        uint64_t slowestNanos = 0;
+        uint64_t totalIterations = 0;
+        uint64_t totalCapped = 0;
+        unsigned cancelled = 0;
+        // What each worker ran, by its threadNumber():
+        struct WorkerCost {
+            uint64_t nanos = 0;
+            uint64_t pixels = 0;
+            uint64_t counts[async_tiled::PERF_COUNTERS] = {};
+        };
+        std::vector<WorkerCost> workerCosts;
+        WorkerCost allCosts;
+        for(size_t i = 0; i < tileMetrics.size(); ++i)
+        {
+            totalNanos += tileMetrics.nanoseconds[i];
+            slowestNanos = std::max<uint64_t>(slowestNanos, tileMetrics.nanoseconds[i]);
+            totalIterations += tileMetrics.iterations[i];
+            totalCapped += tileMetrics.capped[i];
+            cancelled += tileMetrics.cancelled[i];
+            if(tileMetrics.nanoseconds[i] > 0)
+            {
+                workerCosts.resize(std::max<size_t>(workerCosts.size(), tileMetrics.threads[i] + 1));
+                for(WorkerCost* const cost : {&workerCosts[tileMetrics.threads[i]], &allCosts})
+                {
+                    cost->nanos += tileMetrics.nanoseconds[i];
+                    cost->pixels += spec.w * spec.h;
+                    for(unsigned counter = 0; tileMetrics.hardwareCounters && counter < async_tiled::PERF_COUNTERS; ++counter)
+                    {
+                        cost->counts[counter] += tileMetrics.perfCounts[counter][i];
+                    }
+                }
+            }
+        }
+        const double meanNanos = double(totalNanos) / std::max<size_t>(tileMetrics.size(), 1);
+        const auto workers = std::count_if(workerCosts.begin(), workerCosts.end(), [](const WorkerCost& cost) { return cost.nanos > 0; });
+        uint64_t busiestNanos = 0;
+        for(const WorkerCost& cost : workerCosts)
+        {
+            busiestNanos = std::max(busiestNanos, cost.nanos);
+        }
+        std::cerr << "Tiles took " << meanNanos / 1000 << " us on average and " << slowestNanos / 1000 << " us at most ("
+                  << slowestNanos / std::max(meanNanos, 1.0) << " times the mean), iterating " << totalIterations << " times with "
+                  << totalCapped << " pixels reaching --max-iters and " << cancelled << " tiles cancelled. " << workers
+                  << " workers ran tiles, the busiest for " << busiestNanos / 1000 << " us of "
+                  << totalNanos / 1000 << " us in all." << std::endl;
+        if(tileMetrics.hardwareCounters)
+        {
+            const uint32_t counted = tileMetrics.perfCounted;
+            // Instructions per cycle, then each kind of miss per pixel, of the counters that could be read:
+            auto reportCounters = [counted](const WorkerCost& cost)
+            {
+                using async_tiled::PerfCounter;
+                const auto has = [counted](const PerfCounter counter) { return (counted >> unsigned(counter) & 1) != 0; };
+                if(has(PerfCounter::Cycles) && has(PerfCounter::Instructions))
+                {
+                    std::cerr << " IPC " << double(cost.counts[unsigned(PerfCounter::Instructions)]) / std::max<uint64_t>(cost.counts[unsigned(PerfCounter::Cycles)], 1) << ",";
+                }
+                std::cerr << " over " << cost.pixels << " pixels";
+                for(const PerfCounter counter : {PerfCounter::BranchMisses, PerfCounter::L1DMisses, PerfCounter::LLCMisses})
+                {
+                    if(has(counter))
+                    {
+                        std::cerr << ", " << double(cost.counts[unsigned(counter)]) / std::max<uint64_t>(cost.pixels, 1) << " " << async_tiled::perfCounterName(counter) << " per pixel";
+                    }
+                }
+                std::cerr << "." << std::endl;
+            };
+            if(counted == 0)
+            {
+                std::cerr << "Hardware counters are unavailable: " << (async_tiled::perfCountersError() ? async_tiled::perfCountersError() : "none could be read") << "." << std::endl;
+            }
+            else
+            {
+                for(unsigned worker = 0; worker < workerCosts.size(); ++worker)
+                {
+                    if(workerCosts[worker].nanos > 0)
+                    {
+                        std::cerr << "Worker " << worker << ":";
+                        reportCounters(workerCosts[worker]);
+                    }
+                }
+                std::cerr << "All workers:";
+                reportCounters(allCosts);
+                if(async_tiled::perfCountersError())
+                {
+                    std::cerr << "Some counters couldn't be read: " << async_tiled::perfCountersError() << "." << std::endl;
+                }
+            }
+        }
+        if(heatmap)
+        {
+            std::cerr << "Saving tile heatmap as PNG at \"" << OUTPUT_PATH_HEATMAP << "\" ... PNG write result: "
+                      << async_tiled::writeTileHeatmap(OUTPUT_PATH_HEATMAP, tileMetrics, spec, framebufferDims) << std::endl;
+        }
+        // Later frames aren't measured:
+        options.metrics = nullptr;
+    }
+
+    // Render the view again as an interactive viewer would every frame, first allocating afresh each time and then from the arena:
+    if(rerenders > 0 && !deepZoom && !options.state)
+    {
+        for(const bool arena : {false, true})
+        {
+            options.arena = arena ? &frameArena : nullptr;
+            uint64_t launched = 0;
+            uint64_t total = 0;
+            for(unsigned frame = 0; frame < rerenders; ++frame)
+            {
+                frameArena.recycle(std::move(futureTiles));
+                const uint64_t frameStartAllocations = heapAllocations;
+                const uint64_t frameStartThreadAllocations = threadHeapAllocations;
+                futureTiles = async_tiled::mandelbrotAsyncTiled(bounds, maxIters, transaction, transaction, tileGridDims, spec, tiles, framebuffer,
+                                                                iterations, palette, options);
+                launched += threadHeapAllocations - frameStartThreadAllocations;
+                async_tiled::FrameCompletion(futureTiles).wait();
+                total += heapAllocations - frameStartAllocations;
+            }
+            std::cerr << std::endl << "Rendering the view " << rerenders << " more times " << (arena ? "with" : "without") << " a frame arena. Each time:" << std::endl;
+            reportAllocations(launched / rerenders, total / rerenders);
+        }
+    }
+
+    // Changing the palette only needs the escape counts coloured again:
+    const auto recolorStartTime = std::chrono::steady_clock::now();
+    async_tiled::recolor(iterations, framebuffer, framebufferDims, palette, kernels.colorize);
+    const auto recolorMicros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - recolorStartTime).count();
+    std::cerr << "Recolouring the frame took " << recolorMicros << " us." << std::endl;
+
+    // Raise the iteration limit, carrying on from the counts and z the first render left:
+    const async_tiled::Palette refinePalette = fire ? async_tiled::firePalette(refineIters) : async_tiled::greyPalette(refineIters);
+    if(options.state)
+    {
+        const auto refineStartTime = std::chrono::steady_clock::now();
+        const uint64_t refineStartAllocations = heapAllocations;
+        const uint64_t refineStartThreadAllocations = threadHeapAllocations;
+        frameArena.recycle(std::move(futureTiles));
+        futureTiles = async_tiled::mandelbrotAsyncTiled(bounds, refineIters, transaction, transaction, tileGridDims, spec, tiles, framebuffer,
+                                                        iterations, refinePalette, options);
+        const uint64_t refineLaunchAllocations = threadHeapAllocations - refineStartThreadAllocations;
+        waitForTiles(futureTiles);
+        const auto refineMicros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - refineStartTime).count();
+        std::cerr << std::endl << "Refining from " << maxIters << " to " << refineIters << " iterations took " << refineMicros << " us." << std::endl;
+        reportAllocations(refineLaunchAllocations, heapAllocations - refineStartAllocations);
+    }
+
+    // Pan the view, moving the pixels still in view rather than iterating them again:
+    if((panX != 0 || panY != 0) && !deepZoom)
+    {
+        const async_tiled::PlaneBounds pannedBounds = async_tiled::pannedBounds(bounds, framebufferDims, panX, panY);
+        const auto panStartTime = std::chrono::steady_clock::now();
+        const uint64_t panStartAllocations = heapAllocations;
+        const uint64_t panStartThreadAllocations = threadHeapAllocations;
+        frameArena.recycle(std::move(futureTiles));
+        futureTiles = options.state ?
+                async_tiled::mandelbrotAsyncPanned(bounds, pannedBounds, refineIters, transaction, transaction, tileGridDims, spec, tiles, framebuffer,
+                                                   iterations, refinePalette, options) :
+                async_tiled::mandelbrotAsyncPanned(bounds, pannedBounds, maxIters, transaction, transaction, tileGridDims, spec, tiles, framebuffer,
+                                                   iterations, palette, options);
+        const uint64_t panLaunchAllocations = threadHeapAllocations - panStartThreadAllocations;
+        waitForTiles(futureTiles);
+        const auto panMicros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - panStartTime).count();
+        std::cerr << std::endl << "Panning by (" << panX << ", " << panY << ") pixels took " << panMicros << " us." << std::endl;
+        reportAllocations(panLaunchAllocations, heapAllocations - panStartAllocations);
+    }
+
+    // Return to the first view, as a viewer going back to a bookmark would, taking what tiles it can from the cache:
+    if(cacheMegabytes > 0 && !deepZoom && !options.state)
+    {
+        const auto revisitStartTime = std::chrono::steady_clock::now();
+        const uint64_t revisitStartAllocations = heapAllocations;
+        const uint64_t revisitStartThreadAllocations = threadHeapAllocations;
+        frameArena.recycle(std::move(futureTiles));
+        futureTiles = async_tiled::mandelbrotAsyncTiled(bounds, maxIters, transaction, transaction, tileGridDims, spec, tiles, framebuffer,
+                                                        iterations, palette, options);
+        const uint64_t revisitLaunchAllocations = threadHeapAllocations - revisitStartThreadAllocations;
+        waitForTiles(futureTiles);
+        const auto revisitMicros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - revisitStartTime).count();
+        const async_tiled::TileCache::Stats stats = tileCache.stats();
+        std::cerr << std::endl << "Rendering the view again took " << revisitMicros << " us. The tile cache has had " << stats.hits << " hits, "
+                  << stats.misses << " misses and " << stats.evictions << " evictions, and holds " << stats.entries << " tiles in "
+                  << stats.bytes << " bytes." << std::endl;
+        reportAllocations(revisitLaunchAllocations, heapAllocations - revisitStartAllocations);
+    }
+
+    std::cerr << "Saving image as PNG at \"" << OUTPUT_PATH_MANDELBROT << "\" ... ";
+    // Encode to memory and write it ourselves, so the trace shows the two apart:
+    struct PngFile {
+        std::FILE* file;
+        uint64_t encodeStart;
+        bool written;
+    } pngFile = {std::fopen(OUTPUT_PATH_MANDELBROT, "wb"), async_tiled::traceBegin(), false};
+    auto pngResult = pngFile.file && stbi_write_png_to_func([](void* context, void* data, int size)
+    {
+        PngFile& png = *static_cast<PngFile*>(context);
+        async_tiled::traceSpan("png encode", png.encodeStart);
+        const uint64_t writeStart = async_tiled::traceBegin();
+        png.written = std::fwrite(data, 1, size_t(size), png.file) == size_t(size);
+        async_tiled::traceSpan("png write", writeStart);
+    }, &pngFile, framebufferDims.w, framebufferDims.h, 4, &framebuffer[0], framebufferDims.w * sizeof(async_tiled::RGBA)) && pngFile.written;
+    if(pngFile.file && std::fclose(pngFile.file) != 0)
+    {
+        pngResult = false;
+    }
+    std::cerr << "PNG write result: " << pngResult << std::endl;
+
+    // Stress cancellation as junk.cpp sketched, starting frames and abandoning each 1 ms in, timing how long its tiles take to finish:
+    if(cancelFrames > 0 && !deepZoom)
+    {
+        async_tiled::MandelbrotOptions cancelOptions = options;
+        cancelOptions.state = nullptr;
+        cancelOptions.passes = nullptr;
+        cancelOptions.cache = nullptr;
+        async_tiled::TileQueue tileQueue;
+        for(const bool purge : {false, true})
+        {
+            cancelOptions.queue = purge ? &tileQueue : nullptr;
+            long long totalMicros = 0;
+            long long maxMicros = 0;
+            long long totalIdleMicros = 0;
+            size_t purged = 0;
+            for(unsigned frame = 0; frame < cancelFrames; ++frame)
+            {
+                frameArena.recycle(std::move(futureTiles));
+                futureTiles = async_tiled::mandelbrotAsyncTiled(bounds, maxIters, transaction, transaction, tileGridDims, spec, tiles, framebuffer,
+                                                                iterations, palette, cancelOptions);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                const auto cancelTime = std::chrono::steady_clock::now();
+                const async_tiled::Transaction current = ++transaction;
+                if(purge)
+                {
+                    purged += tileQueue.purge(current);
+                }
+                // The next frame's first tile would start once a worker gets to this:
+                std::atomic<long long> idleMicros(-1);
+                stlab::async(stlab::default_executor, [&idleMicros, cancelTime]
+                {
+                    idleMicros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - cancelTime).count();
+                }).detach();
+                async_tiled::FrameCompletion(futureTiles).wait();
+                const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - cancelTime).count();
+                totalMicros += micros;
+                maxMicros = std::max<long long>(maxMicros, micros);
+                while(idleMicros < 0)
+                {
+                    std::this_thread::yield();
+                }
+                totalIdleMicros += idleMicros;
+            }
+            std::cerr << std::endl << (purge ? "Purging queued tiles, " : "Without purging queued tiles, ") << cancelFrames << " frames abandoned 1 ms in took "
+                      << totalMicros / cancelFrames << " us on average and " << maxMicros << " us at most to finish, and a new task could start after "
+                      << totalIdleMicros / cancelFrames << " us on average";
+            if(purge)
+            {
+                std::cerr << ", " << purged << " tiles purged";
+            }
+            std::cerr << "." << std::endl;
+        }
+    }
+
+    if(tracePath)
+    {
+        const long records = async_tiled::writeChromeTrace(tracePath);
+        if(records < 0)
+        {
+            std::cerr << std::endl << "Couldn't write the trace to \"" << tracePath << "\"." << std::endl;
+        }
+        else
+        {
+            std::cerr << std::endl << "Wrote " << records << " trace records to \"" << tracePath << "\"." << std::endl;
+        }
+    }
+
+    std::cerr << std::endl << "Exiting." << std::endl;
+    return 0;
+}
+
+#endif // MANDELBROT_EXAMPLE_NO_MAIN
@@ -0,0 +1,267 @@
+//
+// Copyright Andrew Cox 2017. All rights reserved.
+//
+// Runtime selection between the Mandelbrot kernels compiled for each
+// instruction set and between the precision tiers they iterate with.
+// Built without FP contraction like the kernels, since the multi-double
+// arithmetic below depends on it.
+//
+
+#include "mandelbrot_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define MANDELBROT_KERNELS_X86
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define MANDELBROT_KERNELS_X86
+#endif
+
+#ifdef __unix__
+#include <unistd.h>
+#endif
+
+namespace async_tiled {
+
+    namespace {
+
+        struct CpuFeatures {
+            bool sse2 = false;
+            bool avx2 = false;
+            bool avx512f = false;
+        };
+
+#if defined(MANDELBROT_KERNELS_X86)
+        void cpuid(const unsigned leaf, const unsigned subleaf, unsigned regs[4])
+        {
+#if defined(_MSC_VER)
+            int r[4];
+            __cpuidex(r, int(leaf), int(subleaf));
+            for (int i = 0; i < 4; ++i) { regs[i] = unsigned(r[i]); }
+#else
+            __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        }
+
+        /** The register state the OS saves on context switches (XCR0). */
+        uint64_t xgetbv0()
+        {
+#if defined(_MSC_VER)
+            return _xgetbv(0);
+#else
+            uint32_t eax, edx;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return (uint64_t(edx) << 32) | eax;
+#endif
+        }
+#endif
+
+        CpuFeatures queryCpu()
+        {
+            CpuFeatures features;
+#if defined(MANDELBROT_KERNELS_X86)
+            unsigned regs[4];
+            cpuid(0, 0, regs);
+            const unsigned maxLeaf = regs[0];
+            if (maxLeaf < 1) {
+                return features;
+            }
+            cpuid(1, 0, regs);
+            features.sse2 = (regs[3] & (1u << 26)) != 0;
+            const bool osxsave = (regs[2] & (1u << 27)) != 0;
+            const bool avx = (regs[2] & (1u << 28)) != 0;
+            if (!osxsave || !avx || maxLeaf < 7) {
+                return features;
+            }
+            // The CPU having the instructions isn't enough, the OS has to preserve
+            // the wider registers too:
+            const uint64_t xcr0 = xgetbv0();
+            const bool osYmm = (xcr0 & 0x6) == 0x6;
+            const bool osZmm = (xcr0 & 0xE6) == 0xE6;
+            cpuid(7, 0, regs);
+            features.avx2 = osYmm && (regs[1] & (1u << 5)) != 0;
+            features.avx512f = osZmm && (regs[1] & (1u << 16)) != 0;
+#endif
+            return features;
+        }
+
+        const CpuFeatures &cpuFeatures()
+        {
+            static const CpuFeatures features = queryCpu();
+            return features;
+        }
+
+        const MandelbrotKernels *compiledKernels(const KernelIsa isa)
+        {
+            switch (isa) {
+                case KernelIsa::Scalar: return mandelbrotKernelsScalar();
+                case KernelIsa::SSE2:   return mandelbrotKernelsSSE2();
+                case KernelIsa::AVX2:   return mandelbrotKernelsAVX2();
+                case KernelIsa::AVX512: return mandelbrotKernelsAVX512();
+                case KernelIsa::Auto:   break;
+            }
+            return nullptr;
+        }
+    }
+
+    bool kernelIsaSupported(const KernelIsa isa)
+    {
+        if (compiledKernels(isa) == nullptr) {
+            return false;
+        }
+        const CpuFeatures &features = cpuFeatures();
+        switch (isa) {
+            case KernelIsa::Scalar: return true;
+            case KernelIsa::SSE2:   return features.sse2;
+            case KernelIsa::AVX2:   return features.avx2;
+            case KernelIsa::AVX512: return features.avx512f;
+            case KernelIsa::Auto:   break;
+        }
+        return false;
+    }
+
+    KernelIsa detectKernelIsa()
+    {
+        static const KernelIsa best = [] {
+            for (const KernelIsa isa : {KernelIsa::AVX512, KernelIsa::AVX2, KernelIsa::SSE2}) {
+                if (kernelIsaSupported(isa)) {
+                    return isa;
+                }
+            }
+            return KernelIsa::Scalar;
+        }();
+        return best;
+    }
+
+    const MandelbrotKernels &mandelbrotKernels(const KernelIsa isa)
+    {
+        if (isa != KernelIsa::Auto && kernelIsaSupported(isa)) {
+            return *compiledKernels(isa);
+        }
+        return *compiledKernels(detectKernelIsa());
+    }
+
+    const char *kernelIsaName(const KernelIsa isa)
+    {
+        switch (isa) {
+            case KernelIsa::Auto:   return "auto";
+            case KernelIsa::Scalar: return "scalar";
+            case KernelIsa::SSE2:   return "sse2";
+            case KernelIsa::AVX2:   return "avx2";
+            case KernelIsa::AVX512: return "avx512";
+        }
+        return "unknown";
+    }
+
+    bool parseKernelIsa(const char *const name, KernelIsa &outIsa)
+    {
+        for (const KernelIsa isa : {KernelIsa::Auto, KernelIsa::Scalar, KernelIsa::SSE2, KernelIsa::AVX2, KernelIsa::AVX512}) {
+            if (std::strcmp(name, kernelIsaName(isa)) == 0) {
+                outIsa = isa;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t level2CacheBytes()
+    {
+#ifdef _SC_LEVEL2_CACHE_SIZE
+        const long bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        if (bytes > 0) {
+            return size_t(bytes);
+        }
+#endif
+        return 256 * 1024;
+    }
+
+    PlaneBounds planeBounds(const float left, const float right, const float top, const float bottom)
+    {
+        const auto widen = [](const float x) { return QuadDouble{{x, 0.0, 0.0, 0.0}}; };
+        return {widen(left), widen(right), widen(top), widen(bottom)};
+    }
+
+    namespace {
+
+        DoubleDouble truncateDD(const QuadDouble &x)
+        {
+            return {x.x[0], x.x[1]};
+        }
+    }
+
+    FrameCoords<float> frameCoordsF(const PlaneBounds &bounds, const unsigned w, const unsigned h)
+    {
+        const float left = float(bounds.left.x[0]);
+        const float right = float(bounds.right.x[0]);
+        const float top = float(bounds.top.x[0]);
+        const float bottom = float(bounds.bottom.x[0]);
+        return {left, (right - left) / w, top, (bottom - top) / h};
+    }
+
+    FrameCoords<double> frameCoordsD(const PlaneBounds &bounds, const unsigned w, const unsigned h)
+    {
+        const FrameCoords<QuadDouble> coords = frameCoordsQD(bounds, w, h);
+        return {coords.left.x[0], coords.stepX.x[0], coords.top.x[0], coords.stepY.x[0]};
+    }
+
+    FrameCoords<DoubleDouble> frameCoordsDD(const PlaneBounds &bounds, const unsigned w, const unsigned h)
+    {
+        const FrameCoords<QuadDouble> coords = frameCoordsQD(bounds, w, h);
+        return {truncateDD(coords.left), truncateDD(coords.stepX), truncateDD(coords.top), truncateDD(coords.stepY)};
+    }
+
+    FrameCoords<QuadDouble> frameCoordsQD(const PlaneBounds &bounds, const unsigned w, const unsigned h)
+    {
+        return {bounds.left, divide(bounds.right - bounds.left, double(w)),
+                bounds.top, divide(bounds.bottom - bounds.top, double(h))};
+    }
+
+    Precision selectPrecision(const PlaneBounds &bounds, const unsigned w, const unsigned h, const unsigned maxIters)
+    {
+        // Near the boundary rounding errors are amplified along with everything
+        // else, so allow for more of them to creep in the longer pixels iterate:
+        const double guardBits = 8 + std::log2(double(std::max(maxIters, 1u)));
+        const FrameCoords<double> coords = frameCoordsD(bounds, w, h);
+        const double spacing = std::min(std::fabs(coords.stepX), std::fabs(coords.stepY));
+        const double extent = std::max({std::fabs(bounds.left.x[0]), std::fabs(bounds.right.x[0]),
+                                        std::fabs(bounds.top.x[0]), std::fabs(bounds.bottom.x[0]), spacing});
+        const double bitsNeeded = std::log2(extent / spacing) + guardBits;
+        if (bitsNeeded <= 24) {
+            return Precision::Float;
+        } else if (bitsNeeded <= 53) {
+            return Precision::Double;
+        } else if (bitsNeeded <= 106) {
+            return Precision::DoubleDouble;
+        }
+        return Precision::QuadDouble;
+    }
+
+    const char *precisionName(const Precision precision)
+    {
+        switch (precision) {
+            case Precision::Auto:         return "auto";
+            case Precision::Float:        return "float";
+            case Precision::Double:       return "double";
+            case Precision::DoubleDouble: return "double-double";
+            case Precision::QuadDouble:   return "quad-double";
+        }
+        return "unknown";
+    }
+
+    bool parsePrecision(const char *const name, Precision &outPrecision)
+    {
+        for (const Precision precision : {Precision::Auto, Precision::Float, Precision::Double, Precision::DoubleDouble, Precision::QuadDouble}) {
+            if (std::strcmp(name, precisionName(precision)) == 0) {
+                outPrecision = precision;
+                return true;
+            }
+        }
+        return false;
+    }
+
+} // async_tiled
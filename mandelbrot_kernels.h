@@ -0,0 +1,244 @@
+//
+// Copyright Andrew Cox 2017. All rights reserved.
+//
+// Vectorized escape-time kernels for the Mandelbrot example.
+// Each instruction set lives in its own translation unit compiled with the
+// matching compiler flags (see CMakeLists.txt) and the best one the CPU
+// supports is chosen at startup via CPUID.
+//
+
+#ifndef STLAB_EXPERIMENTS_MANDELBROT_KERNELS_H
+#define STLAB_EXPERIMENTS_MANDELBROT_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "mandelbrot_multidouble.h"
+
+namespace async_tiled {
+
+    /** The instruction set used to iterate pixels. */
+    enum class KernelIsa {
+        /** Pick the widest instruction set the CPU supports. */
+        Auto,
+        Scalar,
+        SSE2,
+        AVX2,
+        AVX512
+    };
+
+    /**
+     * The arithmetic pixels are iterated with. Each tier is slower than the last
+     * but resolves finer pixel spacings before the image turns to blocks.
+     */
+    enum class Precision {
+        /** Pick the cheapest tier that resolves the frame's pixel spacing. */
+        Auto,
+        /** 24 bit mantissa. */
+        Float,
+        /** 53 bit mantissa. */
+        Double,
+        /** About 106 bits. */
+        DoubleDouble,
+        /** About 212 bits. */
+        QuadDouble
+    };
+
+    /**
+     * The corners of a view in the complex plane, held at the highest precision any
+     * tier can use.
+     */
+    struct PlaneBounds {
+        QuadDouble left;
+        QuadDouble right;
+        QuadDouble top;
+        QuadDouble bottom;
+    };
+
+    /** PlaneBounds for a view given with float corners, as mandelbrotAsyncTiled always took. */
+    PlaneBounds planeBounds(float left, float right, float top, float bottom);
+
+    /**
+     * Where pixel (x, y) of a framebuffer is: (left + stepX * x, top + stepY * y),
+     * at the precision of a tier.
+     */
+    template<typename Scalar>
+    struct FrameCoords {
+        Scalar left;
+        Scalar stepX;
+        Scalar top;
+        Scalar stepY;
+    };
+
+    // Each tier's FrameCoords for a framebuffer of w x h pixels spanning bounds.
+    // The float ones use exactly the arithmetic of the original per-pixel loop.
+    FrameCoords<float> frameCoordsF(const PlaneBounds &bounds, unsigned w, unsigned h);
+    FrameCoords<double> frameCoordsD(const PlaneBounds &bounds, unsigned w, unsigned h);
+    FrameCoords<DoubleDouble> frameCoordsDD(const PlaneBounds &bounds, unsigned w, unsigned h);
+    FrameCoords<QuadDouble> frameCoordsQD(const PlaneBounds &bounds, unsigned w, unsigned h);
+
+    /**
+     * The cheapest tier whose mantissa covers the ratio between the largest
+     * coordinate in view and the pixel spacing, plus guard bits for the error
+     * that maxIters iterations accumulate. Views deeper than quad-double
+     * resolves get QuadDouble; use perturbation for those.
+     */
+    Precision selectPrecision(const PlaneBounds &bounds, unsigned w, unsigned h, unsigned maxIters);
+
+    const char *precisionName(Precision precision);
+
+    /**
+     * Parse one of "auto", "float", "double", "double-double", "quad-double".
+     * @return false if the name isn't recognised.
+     */
+    bool parsePrecision(const char *name, Precision &outPrecision);
+
+    /**
+     * How many pixels the kernels proved to be inside the set without iterating
+     * them all the way to maxIters.
+     */
+    struct InteriorCounts {
+        /** Inside the main cardioid, so not iterated at all. */
+        unsigned cardioid = 0;
+        /** Inside the period 2 bulb, so not iterated at all. */
+        unsigned bulb = 0;
+        /** Stopped once their orbit was seen to repeat. */
+        unsigned periodic = 0;
+    };
+
+    /**
+     * Iterate a run of pixels along scanline y0.
+     * Pixel k of the run is at c = (left + stepX * (x0 + k), top + stepY * y0), which is
+     * the same arithmetic the original per-pixel loop used, so every kernel of a tier
+     * produces identical iteration counts.
+     * @param outIters Receives the escape iteration count of each of the count pixels.
+     * @param interior If not null, pixels in the main cardioid or period 2 bulb are
+     * given maxIters without iterating, as are pixels whose orbit settles into a cycle
+     * (found with Brent's method), and the number of each is added here.
+     */
+    template<typename Scalar>
+    using RowKernel = void (*)(Scalar left, Scalar stepX, unsigned x0, Scalar top, Scalar stepY, unsigned y0,
+                               unsigned count, unsigned maxIters, uint32_t *outIters, InteriorCounts *interior);
+
+    using RowKernelF = RowKernel<float>;
+    using RowKernelD = RowKernel<double>;
+    using RowKernelDD = RowKernel<const DoubleDouble &>;
+    using RowKernelQD = RowKernel<const QuadDouble &>;
+
+    /**
+     * Iterate a run of pixels down column x0: pixel k of the run is at
+     * c = (left + stepX * x0, top + stepY * (y0 + k)), giving the same count as
+     * a RowKernel would for that pixel. Otherwise as RowKernel.
+     */
+    template<typename Scalar>
+    using ColumnKernel = RowKernel<Scalar>;
+
+    using ColumnKernelF = ColumnKernel<float>;
+    using ColumnKernelD = ColumnKernel<double>;
+    using ColumnKernelDD = ColumnKernel<const DoubleDouble &>;
+    using ColumnKernelQD = ColumnKernel<const QuadDouble &>;
+
+    /** A resumable pixel's count once it is proven to be inside the set, after which it is never resumed. */
+    constexpr uint32_t ITERS_INTERIOR = UINT32_MAX;
+
+    /**
+     * Carry on iterating a run of pixels along scanline y0 from where an earlier
+     * call stopped, keeping each pixel's z and count in zr, zi and iters between
+     * calls. Pixels start from zero z and count. Pixel k is at the same c as for
+     * RowKernel and is iterated only if iters[k] == fromIters, i.e. it reached the
+     * earlier call's maxIters. It then ends with its escape count, maxIters or
+     * ITERS_INTERIOR, giving the same counts as a RowKernel run to maxIters.
+     * @param interior As for RowKernel, though the cardioid and bulb are only
+     * checked when fromIters is 0 and cycles are only looked for within each call.
+     */
+    template<typename Scalar>
+    using ResumeKernel = void (*)(Scalar left, Scalar stepX, unsigned x0, Scalar top, Scalar stepY, unsigned y0,
+                                  unsigned count, unsigned fromIters, unsigned maxIters,
+                                  std::decay_t<Scalar> *zr, std::decay_t<Scalar> *zi, uint32_t *iters,
+                                  InteriorCounts *interior);
+
+    using ResumeKernelF = ResumeKernel<float>;
+    using ResumeKernelD = ResumeKernel<double>;
+    using ResumeKernelDD = ResumeKernel<const DoubleDouble &>;
+    using ResumeKernelQD = ResumeKernel<const QuadDouble &>;
+
+    /**
+     * Iterate a w x h block of pixels, streaming them through one register's worth
+     * of lanes: as soon as a lane's pixel escapes or reaches maxIters its count is
+     * written out and the lane is refilled with the next pending pixel, so lanes
+     * don't sit idle waiting for the slowest pixel of a group.
+     * Pixel (x, y) of the block is at c = (left + stepX * (x0 + x), top + stepY * (y0 + y)),
+     * matching RowKernelF. Float only.
+     * @param outIters Receives the count of pixel (x, y) at outIters[y * outStride + x].
+     * @param interior As for RowKernel. Cycles are only looked for within each burst
+     * of iteration between refills.
+     */
+    using TileKernelF = void (*)(float left, float stepX, unsigned x0,
+                                 float top, float stepY, unsigned y0,
+                                 unsigned w, unsigned h, unsigned maxIters,
+                                 uint32_t *outIters, unsigned outStride, InteriorCounts *interior);
+
+    /**
+     * Turn a run of escape counts into pixels by looking each one up in a palette:
+     * outPixels[i] = palette[min(counts[i], paletteSize - 1)].
+     */
+    using ColorizeKernel = void (*)(const uint16_t *counts, unsigned count,
+                                    const uint32_t *palette, unsigned paletteSize, uint32_t *outPixels);
+
+    /** The kernels compiled for one instruction set. */
+    struct MandelbrotKernels {
+        KernelIsa isa;
+        /** Number of float pixels iterated per instruction. */
+        unsigned lanesF;
+        /** Number of double pixels iterated per instruction, also used by the multi-double tiers. */
+        unsigned lanesD;
+        RowKernelF rowF;
+        RowKernelD rowD;
+        RowKernelDD rowDD;
+        RowKernelQD rowQD;
+        ColumnKernelF columnF;
+        ColumnKernelD columnD;
+        ColumnKernelDD columnDD;
+        ColumnKernelQD columnQD;
+        /** Lane-refilling alternative to rowF. */
+        TileKernelF laneRefillF;
+        ColorizeKernel colorize;
+        ResumeKernelF resumeF;
+        ResumeKernelD resumeD;
+        ResumeKernelDD resumeDD;
+        ResumeKernelQD resumeQD;
+    };
+
+    /** The widest instruction set that is both compiled in and supported by this CPU. */
+    KernelIsa detectKernelIsa();
+
+    bool kernelIsaSupported(KernelIsa isa);
+
+    /**
+     * Look up the kernels for an instruction set.
+     * Auto, or an instruction set this machine can't run, gives the detected one.
+     */
+    const MandelbrotKernels &mandelbrotKernels(KernelIsa isa);
+
+    const char *kernelIsaName(KernelIsa isa);
+
+    /**
+     * Parse one of "auto", "scalar", "sse2", "avx2", "avx512".
+     * @return false if the name isn't recognised.
+     */
+    bool parseKernelIsa(const char *name, KernelIsa &outIsa);
+
+    /** The size of a core's level 2 cache, or 256 KiB where the OS won't say. */
+    size_t level2CacheBytes();
+
+    // Per instruction set tables. These return nullptr when the translation unit
+    // was built without the instruction set enabled (e.g. on non-x86 targets).
+    const MandelbrotKernels *mandelbrotKernelsScalar();
+    const MandelbrotKernels *mandelbrotKernelsSSE2();
+    const MandelbrotKernels *mandelbrotKernelsAVX2();
+    const MandelbrotKernels *mandelbrotKernelsAVX512();
+
+} // async_tiled
+
+#endif //STLAB_EXPERIMENTS_MANDELBROT_KERNELS_H
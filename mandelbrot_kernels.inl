@@ -0,0 +1,800 @@
+//
+// Copyright Andrew Cox 2017. All rights reserved.
+//
+// Kernel bodies shared by all instruction sets. This is included once by each
+// mandelbrot_kernels_<isa>.cpp after it defines:
+//   MANDELBROT_KERNEL_NS    - a namespace unique to the instruction set, so the
+//                             inline functions below don't collide between
+//                             translation units compiled with different flags.
+//   MANDELBROT_KERNEL_ISA   - the KernelIsa enumerator.
+// and one of MANDELBROT_KERNEL_ISA_SSE2/AVX2/AVX512 (none means scalar).
+// For the same reason nothing here instantiates a template from outside the
+// namespace, such as std::copy, with types from outside it: the linker would
+// keep any one of the copies, perhaps one built for instructions the CPU lacks.
+//
+
+#include <cmath>
+#include <cstdint>
+
+#include "mandelbrot_kernels.h"
+
+#if defined(MANDELBROT_KERNEL_ISA_SSE2) || defined(MANDELBROT_KERNEL_ISA_AVX2) || defined(MANDELBROT_KERNEL_ISA_AVX512)
+#include <immintrin.h>
+#endif
+
+namespace async_tiled {
+namespace MANDELBROT_KERNEL_NS {
+
+    // Minimal vectors of floats and doubles with a per-lane mask for each
+    // instruction set. Counts are kept in the same type as the pixels so every
+    // lane operation stays in one register type; they are exact up to 2^24
+    // iterations.
+
+#if defined(MANDELBROT_KERNEL_ISA_AVX512)
+
+    struct MaskF {
+        __mmask16 m;
+        static MaskF all() { return {__mmask16(0xFFFF)}; }
+        static MaskF fromBits(unsigned b) { return {__mmask16(b)}; }
+    };
+    struct VecF {
+        using Mask = MaskF;
+        static constexpr unsigned lanes = 16;
+        __m512 v;
+        static VecF splat(float x) { return {_mm512_set1_ps(x)}; }
+        /** Lane i holds x0 + i. */
+        static VecF iota(unsigned x0) {
+            const __m512i offsets = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+            return {_mm512_cvtepi32_ps(_mm512_add_epi32(_mm512_set1_epi32(int(x0)), offsets))};
+        }
+        static VecF load(const float *in) { return {_mm512_loadu_ps(in)}; }
+    };
+
+    inline VecF operator+(VecF a, VecF b) { return {_mm512_add_ps(a.v, b.v)}; }
+    inline VecF operator-(VecF a, VecF b) { return {_mm512_sub_ps(a.v, b.v)}; }
+    inline VecF operator*(VecF a, VecF b) { return {_mm512_mul_ps(a.v, b.v)}; }
+    inline VecF absolute(VecF a) { return {_mm512_abs_ps(a.v)}; }
+    inline MaskF operator>=(VecF a, VecF b) { return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ)}; }
+    /** Lanes of b not set in a. */
+    inline MaskF andNot(MaskF a, MaskF b) { return {__mmask16(~a.m & b.m)}; }
+    inline bool any(MaskF m) { return m.m != 0; }
+    inline VecF incrementWhere(VecF count, MaskF m) { return {_mm512_mask_add_ps(count.v, m.m, count.v, _mm512_set1_ps(1.0f))}; }
+    inline void storeCounts(VecF count, uint32_t *out) {
+        _mm512_storeu_si512(reinterpret_cast<void *>(out), _mm512_cvttps_epi32(count.v));
+    }
+    inline void store(VecF a, float *out) { _mm512_storeu_ps(out, a.v); }
+    inline MaskF operator|(MaskF a, MaskF b) { return {__mmask16(a.m | b.m)}; }
+    /** Bit i is set when lane i is. */
+    inline unsigned bits(MaskF m) { return m.m; }
+
+    struct MaskD {
+        __mmask8 m;
+        static MaskD all() { return {__mmask8(0xFF)}; }
+        static MaskD fromBits(unsigned b) { return {__mmask8(b)}; }
+    };
+    struct VecD {
+        using Mask = MaskD;
+        static constexpr unsigned lanes = 8;
+        __m512d v;
+        static VecD splat(double x) { return {_mm512_set1_pd(x)}; }
+        static VecD iota(unsigned x0) {
+            const __m256i offsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            return {_mm512_cvtepi32_pd(_mm256_add_epi32(_mm256_set1_epi32(int(x0)), offsets))};
+        }
+        static VecD load(const double *in) { return {_mm512_loadu_pd(in)}; }
+    };
+
+    inline VecD operator+(VecD a, VecD b) { return {_mm512_add_pd(a.v, b.v)}; }
+    inline VecD operator-(VecD a, VecD b) { return {_mm512_sub_pd(a.v, b.v)}; }
+    inline VecD operator*(VecD a, VecD b) { return {_mm512_mul_pd(a.v, b.v)}; }
+    inline VecD absolute(VecD a) { return {_mm512_abs_pd(a.v)}; }
+    inline MaskD operator>=(VecD a, VecD b) { return {_mm512_cmp_pd_mask(a.v, b.v, _CMP_GE_OQ)}; }
+    inline MaskD andNot(MaskD a, MaskD b) { return {__mmask8(~a.m & b.m)}; }
+    inline bool any(MaskD m) { return m.m != 0; }
+    inline unsigned bits(MaskD m) { return m.m; }
+    inline VecD incrementWhere(VecD count, MaskD m) { return {_mm512_mask_add_pd(count.v, m.m, count.v, _mm512_set1_pd(1.0))}; }
+    inline void storeCounts(VecD count, uint32_t *out) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), _mm512_cvttpd_epi32(count.v));
+    }
+    inline void store(VecD a, double *out) { _mm512_storeu_pd(out, a.v); }
+
+#elif defined(MANDELBROT_KERNEL_ISA_AVX2)
+
+    struct MaskF {
+        __m256 m;
+        static MaskF all() { return {_mm256_castsi256_ps(_mm256_set1_epi32(-1))}; }
+        static MaskF fromBits(unsigned b) {
+            const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+            return {_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(int(b)), laneBits), laneBits))};
+        }
+    };
+    struct VecF {
+        using Mask = MaskF;
+        static constexpr unsigned lanes = 8;
+        __m256 v;
+        static VecF splat(float x) { return {_mm256_set1_ps(x)}; }
+        /** Lane i holds x0 + i. */
+        static VecF iota(unsigned x0) {
+            const __m256i offsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            return {_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(int(x0)), offsets))};
+        }
+        static VecF load(const float *in) { return {_mm256_loadu_ps(in)}; }
+    };
+
+    inline VecF operator+(VecF a, VecF b) { return {_mm256_add_ps(a.v, b.v)}; }
+    inline VecF operator-(VecF a, VecF b) { return {_mm256_sub_ps(a.v, b.v)}; }
+    inline VecF operator*(VecF a, VecF b) { return {_mm256_mul_ps(a.v, b.v)}; }
+    inline VecF absolute(VecF a) { return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)}; }
+    inline MaskF operator>=(VecF a, VecF b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+    /** Lanes of b not set in a. */
+    inline MaskF andNot(MaskF a, MaskF b) { return {_mm256_andnot_ps(a.m, b.m)}; }
+    inline bool any(MaskF m) { return _mm256_movemask_ps(m.m) != 0; }
+    inline VecF incrementWhere(VecF count, MaskF m) { return {_mm256_add_ps(count.v, _mm256_and_ps(m.m, _mm256_set1_ps(1.0f)))}; }
+    inline void storeCounts(VecF count, uint32_t *out) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), _mm256_cvttps_epi32(count.v));
+    }
+    inline void store(VecF a, float *out) { _mm256_storeu_ps(out, a.v); }
+    inline MaskF operator|(MaskF a, MaskF b) { return {_mm256_or_ps(a.m, b.m)}; }
+    /** Bit i is set when lane i is. */
+    inline unsigned bits(MaskF m) { return unsigned(_mm256_movemask_ps(m.m)); }
+
+    struct MaskD {
+        __m256d m;
+        static MaskD all() { return {_mm256_castsi256_pd(_mm256_set1_epi32(-1))}; }
+        static MaskD fromBits(unsigned b) {
+            const __m256i laneBits = _mm256_setr_epi64x(1, 2, 4, 8);
+            return {_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(b), laneBits), laneBits))};
+        }
+    };
+    struct VecD {
+        using Mask = MaskD;
+        static constexpr unsigned lanes = 4;
+        __m256d v;
+        static VecD splat(double x) { return {_mm256_set1_pd(x)}; }
+        static VecD iota(unsigned x0) {
+            return {_mm256_cvtepi32_pd(_mm_add_epi32(_mm_set1_epi32(int(x0)), _mm_setr_epi32(0, 1, 2, 3)))};
+        }
+        static VecD load(const double *in) { return {_mm256_loadu_pd(in)}; }
+    };
+
+    inline VecD operator+(VecD a, VecD b) { return {_mm256_add_pd(a.v, b.v)}; }
+    inline VecD operator-(VecD a, VecD b) { return {_mm256_sub_pd(a.v, b.v)}; }
+    inline VecD operator*(VecD a, VecD b) { return {_mm256_mul_pd(a.v, b.v)}; }
+    inline VecD absolute(VecD a) { return {_mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v)}; }
+    inline MaskD operator>=(VecD a, VecD b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ)}; }
+    inline MaskD andNot(MaskD a, MaskD b) { return {_mm256_andnot_pd(a.m, b.m)}; }
+    inline bool any(MaskD m) { return _mm256_movemask_pd(m.m) != 0; }
+    inline unsigned bits(MaskD m) { return unsigned(_mm256_movemask_pd(m.m)); }
+    inline VecD incrementWhere(VecD count, MaskD m) { return {_mm256_add_pd(count.v, _mm256_and_pd(m.m, _mm256_set1_pd(1.0)))}; }
+    inline void storeCounts(VecD count, uint32_t *out) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm256_cvttpd_epi32(count.v));
+    }
+    inline void store(VecD a, double *out) { _mm256_storeu_pd(out, a.v); }
+
+#elif defined(MANDELBROT_KERNEL_ISA_SSE2)
+
+    struct MaskF {
+        __m128 m;
+        static MaskF all() { return {_mm_castsi128_ps(_mm_set1_epi32(-1))}; }
+        static MaskF fromBits(unsigned b) {
+            const __m128i laneBits = _mm_setr_epi32(1, 2, 4, 8);
+            return {_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(int(b)), laneBits), laneBits))};
+        }
+    };
+    struct VecF {
+        using Mask = MaskF;
+        static constexpr unsigned lanes = 4;
+        __m128 v;
+        static VecF splat(float x) { return {_mm_set1_ps(x)}; }
+        /** Lane i holds x0 + i. */
+        static VecF iota(unsigned x0) {
+            return {_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(int(x0)), _mm_setr_epi32(0, 1, 2, 3)))};
+        }
+        static VecF load(const float *in) { return {_mm_loadu_ps(in)}; }
+    };
+
+    inline VecF operator+(VecF a, VecF b) { return {_mm_add_ps(a.v, b.v)}; }
+    inline VecF operator-(VecF a, VecF b) { return {_mm_sub_ps(a.v, b.v)}; }
+    inline VecF operator*(VecF a, VecF b) { return {_mm_mul_ps(a.v, b.v)}; }
+    inline VecF absolute(VecF a) { return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)}; }
+    inline MaskF operator>=(VecF a, VecF b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+    /** Lanes of b not set in a. */
+    inline MaskF andNot(MaskF a, MaskF b) { return {_mm_andnot_ps(a.m, b.m)}; }
+    inline bool any(MaskF m) { return _mm_movemask_ps(m.m) != 0; }
+    inline VecF incrementWhere(VecF count, MaskF m) { return {_mm_add_ps(count.v, _mm_and_ps(m.m, _mm_set1_ps(1.0f)))}; }
+    inline void storeCounts(VecF count, uint32_t *out) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_cvttps_epi32(count.v));
+    }
+    inline void store(VecF a, float *out) { _mm_storeu_ps(out, a.v); }
+    inline MaskF operator|(MaskF a, MaskF b) { return {_mm_or_ps(a.m, b.m)}; }
+    /** Bit i is set when lane i is. */
+    inline unsigned bits(MaskF m) { return unsigned(_mm_movemask_ps(m.m)); }
+
+    struct MaskD {
+        __m128d m;
+        static MaskD all() { return {_mm_castsi128_pd(_mm_set1_epi32(-1))}; }
+        static MaskD fromBits(unsigned b) {
+            // No 64 bit compare before SSE4.1, so match both halves of each lane:
+            const __m128i laneBits = _mm_setr_epi32(1, 1, 2, 2);
+            return {_mm_castsi128_pd(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(int(b)), laneBits), laneBits))};
+        }
+    };
+    struct VecD {
+        using Mask = MaskD;
+        static constexpr unsigned lanes = 2;
+        __m128d v;
+        static VecD splat(double x) { return {_mm_set1_pd(x)}; }
+        static VecD iota(unsigned x0) {
+            return {_mm_cvtepi32_pd(_mm_add_epi32(_mm_set1_epi32(int(x0)), _mm_setr_epi32(0, 1, 0, 0)))};
+        }
+        static VecD load(const double *in) { return {_mm_loadu_pd(in)}; }
+    };
+
+    inline VecD operator+(VecD a, VecD b) { return {_mm_add_pd(a.v, b.v)}; }
+    inline VecD operator-(VecD a, VecD b) { return {_mm_sub_pd(a.v, b.v)}; }
+    inline VecD operator*(VecD a, VecD b) { return {_mm_mul_pd(a.v, b.v)}; }
+    inline VecD absolute(VecD a) { return {_mm_andnot_pd(_mm_set1_pd(-0.0), a.v)}; }
+    inline MaskD operator>=(VecD a, VecD b) { return {_mm_cmpge_pd(a.v, b.v)}; }
+    inline MaskD andNot(MaskD a, MaskD b) { return {_mm_andnot_pd(a.m, b.m)}; }
+    inline bool any(MaskD m) { return _mm_movemask_pd(m.m) != 0; }
+    inline unsigned bits(MaskD m) { return unsigned(_mm_movemask_pd(m.m)); }
+    inline VecD incrementWhere(VecD count, MaskD m) { return {_mm_add_pd(count.v, _mm_and_pd(m.m, _mm_set1_pd(1.0)))}; }
+    inline void storeCounts(VecD count, uint32_t *out) {
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_cvttpd_epi32(count.v));
+    }
+    inline void store(VecD a, double *out) { _mm_storeu_pd(out, a.v); }
+
+#else // Scalar
+
+    struct MaskF {
+        bool m;
+        static MaskF all() { return {true}; }
+        static MaskF fromBits(unsigned b) { return {(b & 1u) != 0}; }
+    };
+    struct VecF {
+        using Mask = MaskF;
+        static constexpr unsigned lanes = 1;
+        float v;
+        static VecF splat(float x) { return {x}; }
+        static VecF iota(unsigned x0) { return {float(x0)}; }
+        static VecF load(const float *in) { return {*in}; }
+    };
+
+    inline VecF operator+(VecF a, VecF b) { return {a.v + b.v}; }
+    inline VecF operator-(VecF a, VecF b) { return {a.v - b.v}; }
+    inline VecF operator*(VecF a, VecF b) { return {a.v * b.v}; }
+    inline VecF absolute(VecF a) { return {std::fabs(a.v)}; }
+    inline MaskF operator>=(VecF a, VecF b) { return {a.v >= b.v}; }
+    /** Lanes of b not set in a. */
+    inline MaskF andNot(MaskF a, MaskF b) { return {!a.m && b.m}; }
+    inline bool any(MaskF m) { return m.m; }
+    inline VecF incrementWhere(VecF count, MaskF m) { return {m.m ? count.v + 1.0f : count.v}; }
+    inline void storeCounts(VecF count, uint32_t *out) { *out = uint32_t(count.v); }
+    inline void store(VecF a, float *out) { *out = a.v; }
+    inline MaskF operator|(MaskF a, MaskF b) { return {a.m || b.m}; }
+    /** Bit i is set when lane i is. */
+    inline unsigned bits(MaskF m) { return m.m ? 1u : 0u; }
+
+    struct MaskD {
+        bool m;
+        static MaskD all() { return {true}; }
+        static MaskD fromBits(unsigned b) { return {(b & 1u) != 0}; }
+    };
+    struct VecD {
+        using Mask = MaskD;
+        static constexpr unsigned lanes = 1;
+        double v;
+        static VecD splat(double x) { return {x}; }
+        static VecD iota(unsigned x0) { return {double(x0)}; }
+        static VecD load(const double *in) { return {*in}; }
+    };
+
+    inline VecD operator+(VecD a, VecD b) { return {a.v + b.v}; }
+    inline VecD operator-(VecD a, VecD b) { return {a.v - b.v}; }
+    inline VecD operator*(VecD a, VecD b) { return {a.v * b.v}; }
+    inline VecD absolute(VecD a) { return {std::fabs(a.v)}; }
+    inline MaskD operator>=(VecD a, VecD b) { return {a.v >= b.v}; }
+    inline MaskD andNot(MaskD a, MaskD b) { return {!a.m && b.m}; }
+    inline bool any(MaskD m) { return m.m; }
+    inline unsigned bits(MaskD m) { return m.m ? 1u : 0u; }
+    inline VecD incrementWhere(VecD count, MaskD m) { return {m.m ? count.v + 1.0 : count.v}; }
+    inline void storeCounts(VecD count, uint32_t *out) { *out = uint32_t(count.v); }
+    inline void store(VecD a, double *out) { *out = a.v; }
+
+#endif
+
+    // The multi-double operators are in an unnamed namespace, which argument
+    // dependent lookup skips, and the vector ones above would hide them otherwise:
+    using async_tiled::operator+;
+    using async_tiled::operator-;
+    using async_tiled::operator*;
+
+    using VecDD = DoubleDoubleT<VecD>;
+    using VecQD = QuadDoubleT<VecD>;
+
+    /**
+     * How iterateRun builds the pixels of each precision tier. Base is the vector
+     * holding the tier's leading component, which also holds the counts,
+     * Scalar is how the tier's coordinates are passed in and Stored is how a
+     * single lane's value is kept between calls. load and store move a vector's
+     * worth of lanes to and from an array of Stored.
+     * Two points of an orbit closer than tolerance() are taken to be the same
+     * point: a few units in the last place of the tier at |z| ~ 1, which the
+     * precision selection keeps well below the pixel spacing.
+     */
+    template<typename N>
+    struct Tier;
+
+    template<>
+    struct Tier<VecF> {
+        using Base = VecF;
+        using Scalar = float;
+        using Stored = float;
+        static VecF splat(float x) { return VecF::splat(x); }
+        static VecF load(const float *in) { return VecF::load(in); }
+        static void store(VecF a, float *out) { MANDELBROT_KERNEL_NS::store(a, out); }
+        static VecF constant(double x) { return VecF::splat(float(x)); }
+        static VecF index(unsigned i) { return VecF::splat(float(i)); }
+        static VecF laneIndices(unsigned i0) { return VecF::iota(i0); }
+        static VecF hi(VecF a) { return a; }
+        static VecF tolerance() { return VecF::splat(std::ldexp(1.0f, -20)); }
+    };
+
+    template<>
+    struct Tier<VecD> {
+        using Base = VecD;
+        using Scalar = double;
+        using Stored = double;
+        static VecD splat(double x) { return VecD::splat(x); }
+        static VecD load(const double *in) { return VecD::load(in); }
+        static void store(VecD a, double *out) { MANDELBROT_KERNEL_NS::store(a, out); }
+        static VecD constant(double x) { return VecD::splat(x); }
+        static VecD index(unsigned i) { return VecD::splat(double(i)); }
+        static VecD laneIndices(unsigned i0) { return VecD::iota(i0); }
+        static VecD hi(VecD a) { return a; }
+        static VecD tolerance() { return VecD::splat(std::ldexp(1.0, -49)); }
+    };
+
+    template<>
+    struct Tier<VecDD> {
+        using Base = VecD;
+        using Scalar = const DoubleDouble &;
+        using Stored = DoubleDouble;
+        static VecDD splat(const DoubleDouble &x) { return {VecD::splat(x.hi), VecD::splat(x.lo)}; }
+        static VecDD load(const DoubleDouble *in) {
+            double hi[VecD::lanes], lo[VecD::lanes];
+            for (unsigned i = 0; i < VecD::lanes; ++i) {
+                hi[i] = in[i].hi;
+                lo[i] = in[i].lo;
+            }
+            return {VecD::load(hi), VecD::load(lo)};
+        }
+        static void store(const VecDD &a, DoubleDouble *out) {
+            double hi[VecD::lanes], lo[VecD::lanes];
+            MANDELBROT_KERNEL_NS::store(a.hi, hi);
+            MANDELBROT_KERNEL_NS::store(a.lo, lo);
+            for (unsigned i = 0; i < VecD::lanes; ++i) {
+                out[i] = {hi[i], lo[i]};
+            }
+        }
+        static VecDD constant(double x) { return {VecD::splat(x), VecD::splat(0.0)}; }
+        static VecDD index(unsigned i) { return {VecD::splat(double(i)), VecD::splat(0.0)}; }
+        static VecDD laneIndices(unsigned i0) { return {VecD::iota(i0), VecD::splat(0.0)}; }
+        static VecD hi(const VecDD &a) { return a.hi; }
+        static VecD tolerance() { return VecD::splat(std::ldexp(1.0, -100)); }
+    };
+
+    template<>
+    struct Tier<VecQD> {
+        using Base = VecD;
+        using Scalar = const QuadDouble &;
+        using Stored = QuadDouble;
+        static VecQD splat(const QuadDouble &x) {
+            return {{VecD::splat(x.x[0]), VecD::splat(x.x[1]), VecD::splat(x.x[2]), VecD::splat(x.x[3])}};
+        }
+        static VecQD load(const QuadDouble *in) {
+            VecQD a;
+            for (unsigned c = 0; c < 4; ++c) {
+                double component[VecD::lanes];
+                for (unsigned i = 0; i < VecD::lanes; ++i) {
+                    component[i] = in[i].x[c];
+                }
+                a.x[c] = VecD::load(component);
+            }
+            return a;
+        }
+        static void store(const VecQD &a, QuadDouble *out) {
+            for (unsigned c = 0; c < 4; ++c) {
+                double component[VecD::lanes];
+                MANDELBROT_KERNEL_NS::store(a.x[c], component);
+                for (unsigned i = 0; i < VecD::lanes; ++i) {
+                    out[i].x[c] = component[i];
+                }
+            }
+        }
+        static VecQD constant(double x) {
+            return {{VecD::splat(x), VecD::splat(0.0), VecD::splat(0.0), VecD::splat(0.0)}};
+        }
+        static VecQD index(unsigned i) { return constant(double(i)); }
+        static VecQD laneIndices(unsigned i0) {
+            return {{VecD::iota(i0), VecD::splat(0.0), VecD::splat(0.0), VecD::splat(0.0)}};
+        }
+        static VecD hi(const VecQD &a) { return a.x[0]; }
+        static VecD tolerance() { return VecD::splat(std::ldexp(1.0, -200)); }
+    };
+
+    inline unsigned popCount(unsigned b)
+    {
+        unsigned count = 0;
+        for (; b != 0; b &= b - 1) {
+            ++count;
+        }
+        return count;
+    }
+
+    /**
+     * Lanes whose c is inside the main cardioid, where q (q + (x - 1/4)) <= y^2 / 4
+     * with q = (x - 1/4)^2 + y^2, or the period 2 bulb, where (x + 1)^2 + y^2 <= 1/16.
+     * Both are evaluated at the tier's precision as the set's boundary is what a deep
+     * view is looking at.
+     */
+    template<typename N>
+    void interiorRegions(const N &cr, const N &ci, unsigned &outCardioid, unsigned &outBulb)
+    {
+        using T = Tier<N>;
+        using B = typename T::Base;
+        const B zero = B::splat(0.0f);
+        const N quarter = T::constant(0.25);
+        const N ci2 = ci * ci;
+        const N xq = cr - quarter;
+        const N q = xq * xq + ci2;
+        outCardioid = bits(zero >= T::hi(q * (q + xq) - quarter * ci2));
+        const N xb = cr + T::constant(1.0);
+        outBulb = bits(zero >= T::hi(xb * xb + ci2 - T::constant(0.0625))) & ~outCardioid;
+    }
+
+    /**
+     * Iterate z = z^2 + c for a vector's worth of pixels at once, along a row of
+     * pixels starting at (x0, y0) or, if Column, down a column. A lane stops
+     * counting as soon as it escapes and the group finishes when every lane has
+     * escaped or maxIters is reached.
+     */
+    template<typename N, bool Column>
+    void iterateRun(const typename Tier<N>::Scalar left, const typename Tier<N>::Scalar stepX, const unsigned x0,
+                    const typename Tier<N>::Scalar top, const typename Tier<N>::Scalar stepY, const unsigned y0,
+                    const unsigned count, const unsigned maxIters, uint32_t *const outIters,
+                    InteriorCounts *const interior)
+    {
+        using T = Tier<N>;
+        using B = typename T::Base;
+        using Mask = typename B::Mask;
+        constexpr unsigned lanes = B::lanes;
+        const N vLeft = T::splat(left);
+        const N vStepX = T::splat(stepX);
+        const N vTop = T::splat(top);
+        const N vStepY = T::splat(stepY);
+        // The coordinate shared by the whole run:
+        const N fixed = Column ? vLeft + vStepX * T::index(x0) : vTop + vStepY * T::index(y0);
+        const N zero = T::index(0);
+        const B four = B::splat(4.0f);
+        const B tolerance = T::tolerance();
+        for (unsigned x = 0; x < count; x += lanes) {
+            const unsigned groupSize = count - x < lanes ? count - x : lanes;
+            const unsigned groupBits = (1u << groupSize) - 1;
+            const N cr = Column ? fixed : vLeft + vStepX * T::laneIndices(x0 + x);
+            const N ci = Column ? vTop + vStepY * T::laneIndices(y0 + x) : fixed;
+            unsigned cardioid = 0;
+            unsigned bulb = 0;
+            unsigned periodic = 0;
+            if (interior) {
+                interiorRegions(cr, ci, cardioid, bulb);
+            }
+            N zr = zero;
+            N zi = zero;
+            B iters = B::splat(0.0f);
+            Mask active = Mask::fromBits(~(cardioid | bulb));
+            // Brent's cycle detection: compare each z against one saved at
+            // power-of-two iterations, so a cycle of any period is eventually
+            // caught once the orbit has settled onto it.
+            N savedR = zero;
+            N savedI = zero;
+            unsigned saveAt = 1;
+            for (unsigned iter = 0; iter < maxIters && any(active); ++iter) {
+                const N zrNext = zr * zr - zi * zi + cr;
+                zi = zr * zi + zi * zr + ci;
+                zr = zrNext;
+                // The escape test of the original scalar loop, which only needs the leading component:
+                active = andNot(absolute(T::hi(zr) * T::hi(zi)) >= four, active);
+                iters = incrementWhere(iters, active);
+                if (interior) {
+                    const B distance = absolute(T::hi(zr - savedR)) + absolute(T::hi(zi - savedI));
+                    const Mask cycled = andNot(distance >= tolerance, active);
+                    periodic |= bits(cycled);
+                    active = andNot(cycled, active);
+                    if (iter + 1 == saveAt) {
+                        savedR = zr;
+                        savedI = zi;
+                        saveAt *= 2;
+                    }
+                }
+            }
+            uint32_t groupIters[lanes];
+            storeCounts(iters, groupIters);
+            // Lanes past the end of the run iterated harmlessly; drop them.
+            const unsigned inside = (cardioid | bulb | periodic) & groupBits;
+            for (unsigned i = 0; i < groupSize; ++i) {
+                outIters[x + i] = inside & (1u << i) ? maxIters : groupIters[i];
+            }
+            if (interior) {
+                interior->cardioid += popCount(cardioid & groupBits);
+                interior->bulb += popCount(bulb & groupBits);
+                interior->periodic += popCount(periodic & groupBits);
+            }
+        }
+    }
+
+    /**
+     * Carry on iterating a row of pixels from the z and count an earlier call left
+     * them with. Pixels whose count isn't fromIters escaped or were proven inside
+     * the set earlier and are left alone; the others pick up where they stopped,
+     * counting exactly as iterateRun would have had it run to maxIters directly.
+     * The cardioid and bulb tests are only made on a pixel's first pass, and
+     * cycles are only looked for within each pass.
+     */
+    template<typename N>
+    void resumeRun(const typename Tier<N>::Scalar left, const typename Tier<N>::Scalar stepX, const unsigned x0,
+                   const typename Tier<N>::Scalar top, const typename Tier<N>::Scalar stepY, const unsigned y0,
+                   const unsigned count, const unsigned fromIters, const unsigned maxIters,
+                   typename Tier<N>::Stored *const zrState, typename Tier<N>::Stored *const ziState,
+                   uint32_t *const itersState, InteriorCounts *const interior)
+    {
+        using T = Tier<N>;
+        using B = typename T::Base;
+        using Mask = typename B::Mask;
+        using Stored = typename T::Stored;
+        constexpr unsigned lanes = B::lanes;
+        const N vLeft = T::splat(left);
+        const N vStepX = T::splat(stepX);
+        const N ci = T::splat(top) + T::splat(stepY) * T::index(y0);
+        const B four = B::splat(4.0f);
+        const B tolerance = T::tolerance();
+        for (unsigned x = 0; x < count; x += lanes) {
+            const unsigned groupSize = count - x < lanes ? count - x : lanes;
+            unsigned resumable = 0;
+            // Lanes past the end of the run start from 0 and are dropped:
+            Stored laneZr[lanes] = {};
+            Stored laneZi[lanes] = {};
+            for (unsigned i = 0; i < groupSize; ++i) {
+                if (itersState[x + i] == fromIters) {
+                    resumable |= 1u << i;
+                    laneZr[i] = zrState[x + i];
+                    laneZi[i] = ziState[x + i];
+                }
+            }
+            if (resumable == 0) {
+                continue;
+            }
+            const N cr = vLeft + vStepX * T::laneIndices(x0 + x);
+            unsigned cardioid = 0;
+            unsigned bulb = 0;
+            unsigned periodic = 0;
+            if (interior && fromIters == 0) {
+                interiorRegions(cr, ci, cardioid, bulb);
+                cardioid &= resumable;
+                bulb &= resumable;
+            }
+            N zr = T::load(laneZr);
+            N zi = T::load(laneZi);
+            B iters = B::splat(0.0f);
+            Mask active = Mask::fromBits(resumable & ~(cardioid | bulb));
+            N savedR = zr;
+            N savedI = zi;
+            unsigned saveAt = 1;
+            for (unsigned iter = fromIters; iter < maxIters && any(active); ++iter) {
+                const N zrNext = zr * zr - zi * zi + cr;
+                zi = zr * zi + zi * zr + ci;
+                zr = zrNext;
+                active = andNot(absolute(T::hi(zr) * T::hi(zi)) >= four, active);
+                iters = incrementWhere(iters, active);
+                if (interior) {
+                    const B distance = absolute(T::hi(zr - savedR)) + absolute(T::hi(zi - savedI));
+                    const Mask cycled = andNot(distance >= tolerance, active);
+                    periodic |= bits(cycled);
+                    active = andNot(cycled, active);
+                    if (iter + 1 - fromIters == saveAt) {
+                        savedR = zr;
+                        savedI = zi;
+                        saveAt *= 2;
+                    }
+                }
+            }
+            uint32_t groupIters[lanes];
+            storeCounts(iters, groupIters);
+            T::store(zr, laneZr);
+            T::store(zi, laneZi);
+            periodic &= resumable;
+            const unsigned inside = cardioid | bulb | periodic;
+            for (unsigned i = 0; i < groupSize; ++i) {
+                if (resumable & (1u << i)) {
+                    itersState[x + i] = inside & (1u << i) ? ITERS_INTERIOR : fromIters + groupIters[i];
+                    zrState[x + i] = laneZr[i];
+                    ziState[x + i] = laneZi[i];
+                }
+            }
+            if (interior) {
+                interior->cardioid += popCount(cardioid);
+                interior->bulb += popCount(bulb);
+                interior->periodic += popCount(periodic);
+            }
+        }
+    }
+
+    /**
+     * Stream a block of pixels through the lanes of one vector. Lane state lives in
+     * small arrays between bursts of vector iteration; a burst runs until at least
+     * one lane finishes, then finished lanes are written out and refilled with the
+     * next pixel in row-major order.
+     */
+    template<typename V>
+    void iterateBlockLaneRefill(const float left, const float stepX, const unsigned x0,
+                                const float top, const float stepY, const unsigned y0,
+                                const unsigned w, const unsigned h, const unsigned maxIters,
+                                uint32_t *const outIters, const unsigned outStride,
+                                InteriorCounts *const interior)
+    {
+        constexpr unsigned lanes = V::lanes;
+        const unsigned numPixels = w * h;
+        if (maxIters == 0) {
+            for (unsigned y = 0; y < h; ++y) {
+                for (unsigned x = 0; x < w; ++x) {
+                    outIters[y * outStride + x] = 0;
+                }
+            }
+            return;
+        }
+        float zr[lanes], zi[lanes], cr[lanes], ci[lanes], iters[lanes];
+        unsigned pixel[lanes];
+        unsigned live = 0;
+        unsigned next = 0;
+
+        // Point a lane at the next pending pixel or leave it idle if there are none left.
+        // Pixels in the cardioid or bulb are written out straight away instead.
+        auto refill = [&](const unsigned lane) {
+            for (; next < numPixels; ++next) {
+                const unsigned x = next % w;
+                const unsigned y = next / w;
+                const float pixelR = left + stepX * float(x0 + x);
+                const float pixelI = top + stepY * float(y0 + y);
+                if (interior) {
+                    unsigned cardioid, bulb;
+                    interiorRegions(VecF::splat(pixelR), VecF::splat(pixelI), cardioid, bulb);
+                    if ((cardioid | bulb) & 1u) {
+                        interior->cardioid += cardioid & 1u;
+                        interior->bulb += bulb & 1u;
+                        outIters[y * outStride + x] = maxIters;
+                        continue;
+                    }
+                }
+                pixel[lane] = next++;
+                cr[lane] = pixelR;
+                ci[lane] = pixelI;
+                zr[lane] = 0.0f;
+                zi[lane] = 0.0f;
+                iters[lane] = 0.0f;
+                live |= 1u << lane;
+                return;
+            }
+            live &= ~(1u << lane);
+        };
+        for (unsigned lane = 0; lane < lanes; ++lane) {
+            zr[lane] = zi[lane] = cr[lane] = ci[lane] = iters[lane] = 0.0f;
+            refill(lane);
+        }
+
+        const V four = V::splat(4.0f);
+        const V maxCount = V::splat(float(maxIters));
+        const V tolerance = Tier<V>::tolerance();
+        // Refilling costs a round trip through memory so wait for a few lanes to
+        // finish before paying it; finished lanes are masked off in the meantime.
+        const unsigned refillBatch = lanes >= 4 ? lanes / 4 : 1;
+        while (live != 0) {
+            V vzr = V::load(zr);
+            V vzi = V::load(zi);
+            V viters = V::load(iters);
+            const V vcr = V::load(cr);
+            const V vci = V::load(ci);
+            MaskF active = MaskF::fromBits(live);
+            unsigned finished = 0;
+            unsigned periodic = 0;
+            // Brent's cycle detection, restarted each burst:
+            V savedR = vzr;
+            V savedI = vzi;
+            unsigned step = 0;
+            unsigned saveAt = 1;
+            do {
+                const V zrNext = vzr * vzr - vzi * vzi + vcr;
+                vzi = vzr * vzi + vzi * vzr + vci;
+                vzr = zrNext;
+                active = andNot(absolute(vzr * vzi) >= four, active);
+                viters = incrementWhere(viters, active);
+                active = andNot(viters >= maxCount, active);
+                if (interior) {
+                    const MaskF cycled = andNot(absolute(vzr - savedR) + absolute(vzi - savedI) >= tolerance, active);
+                    periodic |= bits(cycled);
+                    active = andNot(cycled, active);
+                    if (++step == saveAt) {
+                        savedR = vzr;
+                        savedI = vzi;
+                        saveAt *= 2;
+                    }
+                }
+                finished = live & ~bits(active);
+            } while (popCount(finished) < refillBatch && finished != live);
+            store(vzr, zr);
+            store(vzi, zi);
+            store(viters, iters);
+
+            for (unsigned lane = 0; lane < lanes; ++lane) {
+                if (finished & (1u << lane)) {
+                    const unsigned p = pixel[lane];
+                    const bool cycled = (periodic & (1u << lane)) != 0;
+                    outIters[(p / w) * outStride + p % w] = cycled ? maxIters : uint32_t(iters[lane]);
+                    if (cycled) {
+                        ++interior->periodic;
+                    }
+                    refill(lane);
+                }
+            }
+        }
+    }
+
+    /**
+     * Palette lookup, eight or sixteen counts at a time where the instruction set
+     * has gathers; SSE2 has none so it shares the scalar loop.
+     */
+    void colorize(const uint16_t *const counts, const unsigned count,
+                  const uint32_t *const palette, const unsigned paletteSize, uint32_t *const outPixels)
+    {
+        const unsigned last = paletteSize - 1;
+        unsigned i = 0;
+#if defined(MANDELBROT_KERNEL_ISA_AVX512)
+        const __m512i vlast = _mm512_set1_epi32(int(last));
+        for (; i + 16 <= count; i += 16) {
+            const __m512i index = _mm512_min_epu32(_mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(counts + i))), vlast);
+            _mm512_storeu_si512(outPixels + i, _mm512_i32gather_epi32(index, palette, 4));
+        }
+#elif defined(MANDELBROT_KERNEL_ISA_AVX2)
+        const __m256i vlast = _mm256_set1_epi32(int(last));
+        for (; i + 8 <= count; i += 8) {
+            const __m256i index = _mm256_min_epu32(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(counts + i))), vlast);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(outPixels + i),
+                                _mm256_i32gather_epi32(reinterpret_cast<const int *>(palette), index, 4));
+        }
+#endif
+        for (; i < count; ++i) {
+            outPixels[i] = palette[counts[i] < last ? counts[i] : last];
+        }
+    }
+
+    const MandelbrotKernels KERNELS = {
+            MANDELBROT_KERNEL_ISA,
+            VecF::lanes,
+            VecD::lanes,
+            &iterateRun<VecF, false>,
+            &iterateRun<VecD, false>,
+            &iterateRun<VecDD, false>,
+            &iterateRun<VecQD, false>,
+            &iterateRun<VecF, true>,
+            &iterateRun<VecD, true>,
+            &iterateRun<VecDD, true>,
+            &iterateRun<VecQD, true>,
+            &iterateBlockLaneRefill<VecF>,
+            &colorize,
+            &resumeRun<VecF>,
+            &resumeRun<VecD>,
+            &resumeRun<VecDD>,
+            &resumeRun<VecQD>
+    };
+
+} // MANDELBROT_KERNEL_NS
+} // async_tiled
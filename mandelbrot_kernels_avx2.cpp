@@ -0,0 +1,28 @@
+//
+// Copyright Andrew Cox 2017. All rights reserved.
+//
+// AVX2 Mandelbrot kernels. This file is compiled with the instruction set
+// enabled (see CMakeLists.txt).
+//
+
+#include "mandelbrot_kernels.h"
+
+#if defined(__AVX2__)
+#define MANDELBROT_KERNEL_ISA_AVX2
+#define MANDELBROT_KERNEL_NS isa_avx2
+#define MANDELBROT_KERNEL_ISA KernelIsa::AVX2
+#include "mandelbrot_kernels.inl"
+#endif
+
+namespace async_tiled {
+
+    const MandelbrotKernels *mandelbrotKernelsAVX2()
+    {
+#if defined(__AVX2__)
+        return &isa_avx2::KERNELS;
+#else
+        return nullptr;
+#endif
+    }
+
+} // async_tiled
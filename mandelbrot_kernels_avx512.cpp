@@ -0,0 +1,28 @@
+//
+// Copyright Andrew Cox 2017. All rights reserved.
+//
+// AVX512 Mandelbrot kernels. This file is compiled with the instruction set
+// enabled (see CMakeLists.txt).
+//
+
+#include "mandelbrot_kernels.h"
+
+#if defined(__AVX512F__)
+#define MANDELBROT_KERNEL_ISA_AVX512
+#define MANDELBROT_KERNEL_NS isa_avx512
+#define MANDELBROT_KERNEL_ISA KernelIsa::AVX512
+#include "mandelbrot_kernels.inl"
+#endif
+
+namespace async_tiled {
+
+    const MandelbrotKernels *mandelbrotKernelsAVX512()
+    {
+#if defined(__AVX512F__)
+        return &isa_avx512::KERNELS;
+#else
+        return nullptr;
+#endif
+    }
+
+} // async_tiled
@@ -0,0 +1,21 @@
+//
+// Copyright Andrew Cox 2017. All rights reserved.
+//
+// Portable one-pixel-at-a-time Mandelbrot kernels, the fallback for CPUs (or
+// build targets) without any of the vector instruction sets.
+//
+
+#include "mandelbrot_kernels.h"
+
+#define MANDELBROT_KERNEL_NS isa_scalar
+#define MANDELBROT_KERNEL_ISA KernelIsa::Scalar
+#include "mandelbrot_kernels.inl"
+
+namespace async_tiled {
+
+    const MandelbrotKernels *mandelbrotKernelsScalar()
+    {
+        return &isa_scalar::KERNELS;
+    }
+
+} // async_tiled
@@ -0,0 +1,28 @@
+//
+// Copyright Andrew Cox 2017. All rights reserved.
+//
+// SSE2 Mandelbrot kernels. This file is compiled with the instruction set
+// enabled (see CMakeLists.txt).
+//
+
+#include "mandelbrot_kernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MANDELBROT_KERNEL_ISA_SSE2
+#define MANDELBROT_KERNEL_NS isa_sse2
+#define MANDELBROT_KERNEL_ISA KernelIsa::SSE2
+#include "mandelbrot_kernels.inl"
+#endif
+
+namespace async_tiled {
+
+    const MandelbrotKernels *mandelbrotKernelsSSE2()
+    {
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        return &isa_sse2::KERNELS;
+#else
+        return nullptr;
+#endif
+    }
+
+} // async_tiled
@@ -0,0 +1,217 @@
+//
+// Copyright Andrew Cox 2017. All rights reserved.
+//
+// Double-double and quad-double arithmetic: numbers held as the unevaluated sum
+// of two or four non-overlapping doubles, giving about 106 and 212 bits of
+// mantissa. The algorithms are branch-free versions of the ones in Hida, Li and
+// Bailey's QD library so they work equally on plain doubles and on vectors of
+// them (any V with +, -, * and a broadcast<V>(double)).
+//
+// The error-free transformations below rely on every operation being rounded
+// individually, so code using them must not be built with FP contraction into
+// FMAs or with -ffast-math.
+//
+
+#ifndef STLAB_EXPERIMENTS_MANDELBROT_MULTIDOUBLE_H
+#define STLAB_EXPERIMENTS_MANDELBROT_MULTIDOUBLE_H
+
+namespace async_tiled {
+
+    template<typename V>
+    struct DoubleDoubleT {
+        V hi;
+        V lo;
+    };
+
+    template<typename V>
+    struct QuadDoubleT {
+        /** Components in order of decreasing magnitude. */
+        V x[4];
+    };
+
+    using DoubleDouble = DoubleDoubleT<double>;
+    using QuadDouble = QuadDoubleT<double>;
+
+    // The function templates have internal linkage: the kernels instantiate them in
+    // translation units built for different instruction sets, and the linker must
+    // never swap an AVX-512 copy in for a portable one.
+    namespace {
+
+        template<typename V>
+        inline V broadcast(double x) { return V::splat(x); }
+
+        template<>
+        inline double broadcast<double>(double x) { return x; }
+
+        /** s + e == a + b exactly. */
+        template<typename V>
+        inline V twoSum(const V a, const V b, V &e)
+        {
+            const V s = a + b;
+            const V bb = s - a;
+            e = (a - (s - bb)) + (b - bb);
+            return s;
+        }
+
+        /** s + e == a + b exactly, given |a| >= |b|. */
+        template<typename V>
+        inline V quickTwoSum(const V a, const V b, V &e)
+        {
+            const V s = a + b;
+            e = b - (s - a);
+            return s;
+        }
+
+        /** Dekker's split of a into two 26 bit halves. */
+        template<typename V>
+        inline void split(const V a, V &hi, V &lo)
+        {
+            const V t = broadcast<V>(134217729.0) * a; // 2^27 + 1
+            hi = t - (t - a);
+            lo = a - hi;
+        }
+
+        /** p + e == a * b exactly. */
+        template<typename V>
+        inline V twoProd(const V a, const V b, V &e)
+        {
+            const V p = a * b;
+            V aHi, aLo, bHi, bLo;
+            split(a, aHi, aLo);
+            split(b, bHi, bLo);
+            e = ((aHi * bHi - p) + aHi * bLo + aLo * bHi) + aLo * bLo;
+            return p;
+        }
+
+        template<typename V>
+        inline DoubleDoubleT<V> operator+(const DoubleDoubleT<V> a, const DoubleDoubleT<V> b)
+        {
+            V e, f;
+            V s = twoSum(a.hi, b.hi, e);
+            const V t = twoSum(a.lo, b.lo, f);
+            e = e + t;
+            s = quickTwoSum(s, e, e);
+            e = e + f;
+            s = quickTwoSum(s, e, e);
+            return {s, e};
+        }
+
+        template<typename V>
+        inline DoubleDoubleT<V> operator-(const DoubleDoubleT<V> a, const DoubleDoubleT<V> b)
+        {
+            const V zero = broadcast<V>(0.0);
+            return a + DoubleDoubleT<V>{zero - b.hi, zero - b.lo};
+        }
+
+        template<typename V>
+        inline DoubleDoubleT<V> operator*(const DoubleDoubleT<V> a, const DoubleDoubleT<V> b)
+        {
+            V e;
+            V p = twoProd(a.hi, b.hi, e);
+            e = e + (a.hi * b.lo + a.lo * b.hi);
+            p = quickTwoSum(p, e, e);
+            return {p, e};
+        }
+
+        template<typename V>
+        inline void threeSum(V &a, V &b, V &c)
+        {
+            V t2, t3;
+            const V t1 = twoSum(a, b, t2);
+            a = twoSum(c, t1, t3);
+            b = twoSum(t2, t3, c);
+        }
+
+        template<typename V>
+        inline void threeSum2(V &a, V &b, const V c)
+        {
+            V t2, t3;
+            const V t1 = twoSum(a, b, t2);
+            a = twoSum(c, t1, t3);
+            b = t2 + t3;
+        }
+
+        /**
+         * Fold five overlapping components into four. The QD library branches
+         * around zero components here; two sweeps without branches is slightly
+         * less tight but keeps every lane of a vector doing the same thing.
+         */
+        template<typename V>
+        inline QuadDoubleT<V> renormalize(V c0, V c1, V c2, V c3, V c4)
+        {
+            V s = quickTwoSum(c3, c4, c4);
+            s = quickTwoSum(c2, s, c3);
+            s = quickTwoSum(c1, s, c2);
+            c0 = quickTwoSum(c0, s, c1);
+            c0 = twoSum(c0, c1, c1);
+            c1 = twoSum(c1, c2, c2);
+            c2 = twoSum(c2, c3, c3);
+            return {{c0, c1, c2, c3 + c4}};
+        }
+
+        template<typename V>
+        inline QuadDoubleT<V> operator+(const QuadDoubleT<V> &a, const QuadDoubleT<V> &b)
+        {
+            V t0, t1, t2, t3;
+            const V s0 = twoSum(a.x[0], b.x[0], t0);
+            V s1 = twoSum(a.x[1], b.x[1], t1);
+            V s2 = twoSum(a.x[2], b.x[2], t2);
+            V s3 = twoSum(a.x[3], b.x[3], t3);
+            s1 = twoSum(s1, t0, t0);
+            threeSum(s2, t0, t1);
+            threeSum2(s3, t0, t2);
+            t0 = t0 + t1 + t3;
+            return renormalize(s0, s1, s2, s3, t0);
+        }
+
+        template<typename V>
+        inline QuadDoubleT<V> operator-(const QuadDoubleT<V> &a, const QuadDoubleT<V> &b)
+        {
+            const V zero = broadcast<V>(0.0);
+            return a + QuadDoubleT<V>{{zero - b.x[0], zero - b.x[1], zero - b.x[2], zero - b.x[3]}};
+        }
+
+        template<typename V>
+        inline QuadDoubleT<V> operator*(const QuadDoubleT<V> &a, const QuadDoubleT<V> &b)
+        {
+            V q0, q1, q2, q3, q4, q5, t0, t1;
+            const V p0 = twoProd(a.x[0], b.x[0], q0);
+            V p1 = twoProd(a.x[0], b.x[1], q1);
+            V p2 = twoProd(a.x[1], b.x[0], q2);
+            V p3 = twoProd(a.x[0], b.x[2], q3);
+            V p4 = twoProd(a.x[1], b.x[1], q4);
+            V p5 = twoProd(a.x[2], b.x[0], q5);
+            threeSum(p1, p2, q0);
+            threeSum(p2, q1, q2);
+            threeSum(p3, p4, p5);
+            // (s0, s1, s2) = (p2, q1, q2) + (p3, p4, p5):
+            const V s0 = twoSum(p2, p3, t0);
+            V s1 = twoSum(q1, p4, t1);
+            V s2 = q2 + p5;
+            s1 = twoSum(s1, t0, t0);
+            s2 = s2 + (t0 + t1);
+            // The O(eps^3) terms:
+            s1 = s1 + (a.x[0] * b.x[3] + a.x[1] * b.x[2] + a.x[2] * b.x[1] + a.x[3] * b.x[0] + q0 + q3 + q4 + q5);
+            return renormalize(p0, p1, s0, s1, s2);
+        }
+
+        /** a / b for a plain double b, by long division one component at a time. */
+        template<typename V>
+        inline QuadDoubleT<V> divide(const QuadDoubleT<V> &a, const V b)
+        {
+            const V zero = broadcast<V>(0.0);
+            QuadDoubleT<V> remainder = a;
+            V q[4];
+            for (int i = 0; i < 4; ++i) {
+                q[i] = remainder.x[0] / b;
+                V e;
+                const V p = twoProd(q[i], b, e);
+                remainder = remainder - QuadDoubleT<V>{{p, e, zero, zero}};
+            }
+            return renormalize(q[0], q[1], q[2], q[3], zero);
+        }
+    }
+
+} // async_tiled
+
+#endif //STLAB_EXPERIMENTS_MANDELBROT_MULTIDOUBLE_H
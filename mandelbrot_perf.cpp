@@ -0,0 +1,154 @@
+//
+// Copyright Andrew Cox 2017. All rights reserved.
+//
+
+#include "mandelbrot_perf.h"
+
+#include <atomic>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace async_tiled {
+
+    namespace {
+
+        std::atomic<const char*> lastError(nullptr);
+
+#ifdef __linux__
+        const char* describeError(const int error)
+        {
+            switch(error)
+            {
+                case EACCES:
+                case EPERM:
+                    return "not permitted, see /proc/sys/kernel/perf_event_paranoid";
+                case ENOENT:
+                case EOPNOTSUPP:
+                    return "the CPU or kernel doesn't count these events";
+                case ENOSYS:
+                    return "the kernel has no perf_event_open";
+                default:
+                    return "perf_event_open failed";
+            }
+        }
+
+        /** A thread's counters, a perf event group led by the first of them that opened. */
+        struct PerfGroup {
+            ~PerfGroup()
+            {
+                for(unsigned i = 0; i < members; ++i)
+                {
+                    close(fds[i]);
+                }
+            }
+
+            /** Open what counters we can, once. */
+            void open()
+            {
+                if(opened)
+                {
+                    return;
+                }
+                opened = true;
+                static const struct { uint32_t type; uint64_t config; } events[PERF_COUNTERS] = {
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+                    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                };
+                for(unsigned counter = 0; counter < PERF_COUNTERS; ++counter)
+                {
+                    perf_event_attr attr;
+                    std::memset(&attr, 0, sizeof(attr));
+                    attr.size = sizeof(attr);
+                    attr.type = events[counter].type;
+                    attr.config = events[counter].config;
+                    attr.read_format = PERF_FORMAT_GROUP;
+                    // Only this thread's user space work, which is all an unprivileged process may count:
+                    attr.exclude_kernel = 1;
+                    attr.exclude_hv = 1;
+                    const int fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, members > 0 ? fds[0] : -1, 0));
+                    if(fd < 0)
+                    {
+                        lastError = describeError(errno);
+                        continue;
+                    }
+                    fds[members] = fd;
+                    order[members] = counter;
+                    ++members;
+                    counted |= 1u << counter;
+                }
+            }
+
+            bool read(PerfSample& out)
+            {
+                out = {};
+                open();
+                if(members == 0)
+                {
+                    return false;
+                }
+                // With PERF_FORMAT_GROUP the leader reads the whole group: the number of events, then each one's count:
+                uint64_t values[1 + PERF_COUNTERS];
+                const ssize_t bytes = ::read(fds[0], values, sizeof(values));
+                if(bytes < ssize_t(sizeof(uint64_t) * (1 + members)) || values[0] != members)
+                {
+                    return false;
+                }
+                for(unsigned i = 0; i < members; ++i)
+                {
+                    out.values[order[i]] = values[1 + i];
+                }
+                out.counted = counted;
+                return true;
+            }
+
+            bool opened = false;
+            unsigned members = 0;
+            int fds[PERF_COUNTERS];
+            /** The PerfCounter of each member, in the order they were added to the group. */
+            unsigned order[PERF_COUNTERS];
+            uint32_t counted = 0;
+        };
+
+        thread_local PerfGroup threadGroup;
+#endif
+    }
+
+    const char* perfCounterName(const PerfCounter counter)
+    {
+        switch(counter)
+        {
+            case PerfCounter::Cycles: return "cycles";
+            case PerfCounter::Instructions: return "instructions";
+            case PerfCounter::BranchMisses: return "branch misses";
+            case PerfCounter::L1DMisses: return "L1D misses";
+            case PerfCounter::LLCMisses: return "LLC misses";
+        }
+        return "?";
+    }
+
+    bool readPerfCounters(PerfSample& out)
+    {
+#ifdef __linux__
+        return threadGroup.read(out);
+#else
+        out = {};
+        lastError = "hardware counters are only read on Linux";
+        return false;
+#endif
+    }
+
+    const char* perfCountersError()
+    {
+        return lastError;
+    }
+
+} // async_tiled
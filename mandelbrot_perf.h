@@ -0,0 +1,54 @@
+//
+// Copyright Andrew Cox 2017. All rights reserved.
+//
+// Hardware performance counters for the Mandelbrot example, read with Linux's
+// perf_event_open: each thread opens a group of counters of its own user space
+// events the first time it reads them, so the difference between two reads on
+// a thread is what ran on it in between. Where the counters can't be opened,
+// as in many containers and on other platforms, reads report nothing counted
+// and perfCountersError() says why.
+//
+
+#ifndef STLAB_EXPERIMENTS_MANDELBROT_PERF_H
+#define STLAB_EXPERIMENTS_MANDELBROT_PERF_H
+
+#include <cstdint>
+
+namespace async_tiled {
+
+    /** The events counted, and their indices in PerfSample::values. */
+    enum class PerfCounter {
+        Cycles,
+        Instructions,
+        BranchMisses,
+        /** Level 1 data cache read misses. */
+        L1DMisses,
+        /** Last level cache misses. */
+        LLCMisses
+    };
+
+    constexpr unsigned PERF_COUNTERS = 5;
+
+    /** The counts of a thread's events so far. */
+    struct PerfSample {
+        uint64_t values[PERF_COUNTERS];
+        /** A bit per PerfCounter, set for those counted. Values of the others are 0. */
+        uint32_t counted;
+    };
+
+    /** A short name for a counter, such as "cycles". */
+    const char* perfCounterName(PerfCounter counter);
+
+    /**
+     * Read the calling thread's counters, opening them on its first read. Events
+     * the CPU or kernel won't count are left out.
+     * @return False if none of them could be opened.
+     */
+    bool readPerfCounters(PerfSample& out);
+
+    /** Why the counters a thread last failed to open couldn't be, or null if none have failed. */
+    const char* perfCountersError();
+
+} // async_tiled
+
+#endif // STLAB_EXPERIMENTS_MANDELBROT_PERF_H
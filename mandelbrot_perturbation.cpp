@@ -0,0 +1,157 @@
+//
+// Copyright Andrew Cox 2017. All rights reserved.
+//
+
+#include "mandelbrot_perturbation.h"
+
+#include <cmath>
+#include <limits>
+
+#include <boost/multiprecision/cpp_bin_float.hpp>
+
+namespace async_tiled {
+
+    namespace {
+
+        /** The escape test used by all the Mandelbrot kernels. */
+        inline bool escaped(const std::complex<double> z)
+        {
+            return std::fabs(z.real() * z.imag()) >= 4.0;
+        }
+
+        template<unsigned Bits>
+        void iterateReference(const std::string& centerRe, const std::string& centerIm,
+                              const unsigned maxIters, ReferenceOrbit& orbit)
+        {
+            using namespace boost::multiprecision;
+            using BigFloat = number<cpp_bin_float<Bits, digit_base_2>, et_off>;
+            const BigFloat cr(centerRe);
+            const BigFloat ci(centerIm);
+            BigFloat zr = 0;
+            BigFloat zi = 0;
+            orbit.precisionBits = Bits;
+            orbit.z.reserve(maxIters + 1);
+            orbit.z.emplace_back(0.0, 0.0);
+            for (unsigned n = 0; n < maxIters; ++n) {
+                const BigFloat zrNext = zr * zr - zi * zi + cr;
+                zi = 2 * zr * zi + ci;
+                zr = zrNext;
+                const std::complex<double> z(zr.template convert_to<double>(), zi.template convert_to<double>());
+                orbit.z.push_back(z);
+                if (escaped(z)) {
+                    break;
+                }
+            }
+        }
+
+        /**
+         * Find how many iterations the cubic series dz_n = A_n dc + B_n dc^2 + C_n dc^3
+         * can stand in for across the whole frame.
+         * We stop before the dropped higher order terms (estimated by the cubic one)
+         * stop being lost in the rounding of the linear term, since near the boundary
+         * any error in dz is amplified over the remaining iterations much like a
+         * rounding error would be, and while the offsets are still tiny next to the
+         * reference orbit so no pixel can escape or need rebasing inside the skipped
+         * iterations.
+         */
+        void approximateSeries(const double maxDelta, ReferenceOrbit& orbit)
+        {
+            constexpr double MAX_RELATIVE_ERROR = std::numeric_limits<double>::epsilon();
+            constexpr double MAX_OFFSET_RATIO = 1.0 / 1024;
+            const double r = maxDelta;
+            std::complex<double> a, b, c;
+            // The last orbit entry has no successor for pixels to step from without a rebase:
+            for (size_t n = 0; n + 2 < orbit.z.size(); ++n) {
+                const std::complex<double> twoZ = 2.0 * orbit.z[n];
+                const std::complex<double> nextA = twoZ * a + 1.0;
+                const std::complex<double> nextB = twoZ * b + a * a;
+                const std::complex<double> nextC = twoZ * c + 2.0 * a * b;
+                const double absA = std::abs(nextA);
+                // |C dc^3| / |A dc|, ordered to stay in range for very small r:
+                const double truncation = std::abs(nextC) / absA * r * r;
+                const double offsetBound = absA * r + std::abs(nextB) * r * r + std::abs(nextC) * r * r * r;
+                // Once the reference is outside |Z| = 2 it only grows, squaring relative
+                // errors each step, so the series is only trusted while it's bounded:
+                if (!std::isfinite(truncation) || !std::isfinite(offsetBound) ||
+                    truncation > MAX_RELATIVE_ERROR ||
+                    offsetBound > MAX_OFFSET_RATIO * std::abs(orbit.z[n + 1]) ||
+                    std::norm(orbit.z[n + 1]) > 4.0) {
+                    break;
+                }
+                a = nextA;
+                b = nextB;
+                c = nextC;
+                orbit.skipIters = unsigned(n + 1);
+            }
+            orbit.a = a;
+            orbit.b = b;
+            orbit.c = c;
+        }
+    }
+
+    PlaneBounds planeBounds(const DeepView& view, const unsigned w, const unsigned h)
+    {
+        using namespace boost::multiprecision;
+        // A few more bits than quad-double holds:
+        using BigFloat = number<cpp_bin_float<256, digit_base_2>, et_off>;
+        const BigFloat cr(view.centerRe);
+        const BigFloat ci(view.centerIm);
+        const BigFloat halfWidth = BigFloat(view.width) / 2;
+        const BigFloat halfHeight = halfWidth * h / w;
+        const auto toQuadDouble = [](BigFloat x) {
+            QuadDouble q;
+            for (double& component : q.x) {
+                component = x.convert_to<double>();
+                x -= component;
+            }
+            return q;
+        };
+        return {toQuadDouble(cr - halfWidth), toQuadDouble(cr + halfWidth),
+                toQuadDouble(ci + halfHeight), toQuadDouble(ci - halfHeight)};
+    }
+
+    std::shared_ptr<const ReferenceOrbit> computeReferenceOrbit(
+            const std::string& centerRe, const std::string& centerIm,
+            const unsigned maxIters, const double maxDelta, const double pixelSpacing)
+    {
+        auto orbit = std::make_shared<ReferenceOrbit>();
+        // Enough bits to place the centre to well under a pixel, relative to |c| <= 2:
+        const double bitsNeeded = std::log2(2.0 / pixelSpacing) + 32;
+        if (bitsNeeded <= 128) {
+            iterateReference<128>(centerRe, centerIm, maxIters, *orbit);
+        } else if (bitsNeeded <= 256) {
+            iterateReference<256>(centerRe, centerIm, maxIters, *orbit);
+        } else if (bitsNeeded <= 512) {
+            iterateReference<512>(centerRe, centerIm, maxIters, *orbit);
+        } else {
+            // Beyond this the double offsets underflow anyway.
+            iterateReference<1088>(centerRe, centerIm, maxIters, *orbit);
+        }
+        approximateSeries(maxDelta, *orbit);
+        return orbit;
+    }
+
+    unsigned iteratePerturbed(const ReferenceOrbit& orbit, const std::complex<double> dc, const unsigned maxIters, unsigned& outRebases)
+    {
+        const std::vector<std::complex<double>>& z = orbit.z;
+        const size_t last = z.size() - 1;
+        size_t m = orbit.skipIters;
+        std::complex<double> dz = dc * (orbit.a + dc * (orbit.b + dc * orbit.c));
+        for (unsigned n = orbit.skipIters; n < maxIters; ++n) {
+            // z_n+1 = z_n^2 + c with z_n = Z_m + dz and c = C + dc:
+            dz = (2.0 * z[m] + dz) * dz + dc;
+            ++m;
+            const std::complex<double> pixelZ = z[m] + dz;
+            if (escaped(pixelZ)) {
+                return n;
+            }
+            if (m == last || std::norm(pixelZ) < std::norm(dz)) {
+                dz = pixelZ;
+                m = 0;
+                ++outRebases;
+            }
+        }
+        return maxIters;
+    }
+
+} // async_tiled
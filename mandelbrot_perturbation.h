@@ -0,0 +1,79 @@
+//
+// Copyright Andrew Cox 2017. All rights reserved.
+//
+// Deep zoom support for the Mandelbrot example using perturbation theory:
+// one reference orbit is iterated at high precision for the whole frame and
+// every pixel then iterates only its small offset from that orbit in double.
+//
+
+#ifndef STLAB_EXPERIMENTS_MANDELBROT_PERTURBATION_H
+#define STLAB_EXPERIMENTS_MANDELBROT_PERTURBATION_H
+
+#include <complex>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mandelbrot_kernels.h"
+
+namespace async_tiled {
+
+    /**
+     * A view too deep to describe with float bounds. The centre is given as
+     * decimal strings so it can carry as many digits as the zoom needs.
+     */
+    struct DeepView {
+        std::string centerRe;
+        std::string centerIm;
+        /** Width of the framebuffer in the complex plane. */
+        double width;
+    };
+
+    /**
+     * The bounds of a w x h framebuffer showing view, with its pixels placed as
+     * iteratePerturbed places them, for rendering it directly at one of the
+     * precision tiers instead.
+     */
+    PlaneBounds planeBounds(const DeepView& view, unsigned w, unsigned h);
+
+    /**
+     * The orbit of the view's centre, rounded to double after being iterated at
+     * high precision, plus the series approximation that lets pixels skip the
+     * first skipIters iterations. Built once per frame and shared read-only by
+     * all the tile tasks.
+     */
+    struct ReferenceOrbit {
+        /** Z_0 = 0 up to and including the first escaped value or Z_maxIters. */
+        std::vector<std::complex<double>> z;
+        /** Iterations every pixel starts from, using the series below. */
+        unsigned skipIters = 0;
+        /** dz_skipIters ~= a * dc + b * dc^2 + c * dc^3 */
+        std::complex<double> a;
+        std::complex<double> b;
+        std::complex<double> c;
+        /** Bits of precision the orbit was computed with. */
+        unsigned precisionBits = 0;
+    };
+
+    /**
+     * Iterate the centre of the view at enough precision to resolve its pixels.
+     * @param maxDelta The largest |dc| of any pixel in the frame, used to bound the
+     * error of the series approximation.
+     * @param pixelSpacing Distance between pixel centres in the complex plane.
+     */
+    std::shared_ptr<const ReferenceOrbit> computeReferenceOrbit(
+            const std::string& centerRe, const std::string& centerIm,
+            unsigned maxIters, double maxDelta, double pixelSpacing);
+
+    /**
+     * Escape iteration count of the pixel at centre + dc.
+     * Whenever the pixel's orbit gets closer to zero than its offset from the
+     * reference, the offset has lost the precision it needs (a "glitch"), so the
+     * pixel is rebased: its offset becomes its full value, relative to Z_0 = 0.
+     * @param outRebases Incremented for each rebase.
+     */
+    unsigned iteratePerturbed(const ReferenceOrbit& orbit, std::complex<double> dc, unsigned maxIters, unsigned& outRebases);
+
+} // async_tiled
+
+#endif //STLAB_EXPERIMENTS_MANDELBROT_PERTURBATION_H
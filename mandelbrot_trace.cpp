@@ -0,0 +1,141 @@
+//
+// Copyright Andrew Cox 2017. All rights reserved.
+//
+
+#include "mandelbrot_trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace async_tiled {
+
+    namespace detail {
+        std::atomic<bool> tracingOn(false);
+    }
+
+    namespace {
+
+        /** The records of one thread, written only by that thread. */
+        struct TraceRing {
+            explicit TraceRing(const unsigned thread) : records(new TraceRecord[TRACE_RING_RECORDS]), thread(thread) {}
+
+            std::unique_ptr<TraceRecord[]> records;
+            /** How many records have ever been appended; the next goes at head % TRACE_RING_RECORDS. */
+            std::atomic<uint64_t> head{0};
+            /** The thread's number in the trace. */
+            const unsigned thread;
+        };
+
+        /** Every thread's ring, kept after the thread exits so its records can still be written out. */
+        std::mutex ringsMutex;
+        std::vector<std::unique_ptr<TraceRing>> rings;
+
+        thread_local TraceRing* threadRing = nullptr;
+
+        std::atomic<unsigned> threadsNumbered(0);
+
+        TraceRing& registerRing()
+        {
+            const unsigned thread = threadNumber();
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            rings.push_back(std::unique_ptr<TraceRing>(new TraceRing(thread)));
+            return *rings.back();
+        }
+
+        void writeRecord(std::FILE* const file, const TraceRecord& record, const unsigned thread, const uint64_t origin, bool& first)
+        {
+            // Chrome trace timestamps are in microseconds:
+            const double ts = (record.begin - origin) / 1000.0;
+            std::fprintf(file, "%s\n{\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,", first ? "" : ",", record.name, thread, ts);
+            if(record.end > record.begin)
+            {
+                std::fprintf(file, "\"ph\":\"X\",\"dur\":%.3f,", (record.end - record.begin) / 1000.0);
+            }
+            else
+            {
+                std::fprintf(file, "\"ph\":\"i\",\"s\":\"t\",");
+            }
+            std::fprintf(file, "\"args\":{\"x\":%u,\"y\":%u", unsigned(record.x), unsigned(record.y));
+            for(unsigned i = 0; record.valueNames && i < 4; ++i)
+            {
+                if(record.valueNames[i])
+                {
+                    std::fprintf(file, ",\"%s\":%u", record.valueNames[i], record.values[i]);
+                }
+            }
+            std::fprintf(file, "}}");
+            first = false;
+        }
+    }
+
+    void setTracing(const bool on)
+    {
+        detail::tracingOn.store(on, std::memory_order_relaxed);
+    }
+
+    unsigned threadNumber()
+    {
+        thread_local const unsigned number = threadsNumbered.fetch_add(1, std::memory_order_relaxed);
+        return number;
+    }
+
+    uint64_t traceClock()
+    {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    void recordTrace(const TraceRecord& record)
+    {
+        if(!threadRing)
+        {
+            threadRing = &registerRing();
+        }
+        // Only this thread writes its ring, so the head needs no read-modify-write:
+        const uint64_t head = threadRing->head.load(std::memory_order_relaxed);
+        threadRing->records[head & (TRACE_RING_RECORDS - 1)] = record;
+        threadRing->head.store(head + 1, std::memory_order_release);
+    }
+
+    long writeChromeTrace(const char* const path)
+    {
+        std::FILE* const file = std::fopen(path, "w");
+        if(!file)
+        {
+            return -1;
+        }
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        // Times are written from the earliest record still held:
+        std::vector<uint64_t> heads;
+        uint64_t origin = UINT64_MAX;
+        for(const auto& ring : rings)
+        {
+            heads.push_back(ring->head.load(std::memory_order_acquire));
+            for(uint64_t i = heads.back() > TRACE_RING_RECORDS ? heads.back() - TRACE_RING_RECORDS : 0; i < heads.back(); ++i)
+            {
+                origin = std::min(origin, ring->records[i & (TRACE_RING_RECORDS - 1)].begin);
+            }
+        }
+        std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+        bool first = true;
+        long written = 0;
+        for(unsigned r = 0; r < rings.size(); ++r)
+        {
+            std::fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+                         first ? "" : ",", rings[r]->thread, rings[r]->thread);
+            first = false;
+            const uint64_t oldest = heads[r] > TRACE_RING_RECORDS ? heads[r] - TRACE_RING_RECORDS : 0;
+            for(uint64_t i = oldest; i < heads[r]; ++i)
+            {
+                writeRecord(file, rings[r]->records[i & (TRACE_RING_RECORDS - 1)], rings[r]->thread, origin, first);
+                ++written;
+            }
+        }
+        std::fprintf(file, "\n]}\n");
+        return std::fclose(file) == 0 ? written : -1;
+    }
+
+} // async_tiled
@@ -0,0 +1,110 @@
+//
+// Copyright Andrew Cox 2017. All rights reserved.
+//
+// Low overhead tracing for the Mandelbrot example: each thread appends
+// timestamped records to a ring buffer of its own, without locks, and the
+// rings can be written out as a Chrome trace to view in about:tracing or
+// Perfetto. Tracing is compiled in but off until setTracing(true), when a
+// trace call costs a relaxed load and a branch.
+//
+
+#ifndef STLAB_EXPERIMENTS_MANDELBROT_TRACE_H
+#define STLAB_EXPERIMENTS_MANDELBROT_TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace async_tiled {
+
+    /** Each thread's ring keeps its last this many records. A power of two. */
+    constexpr size_t TRACE_RING_RECORDS = size_t(1) << 14;
+
+    /**
+     * One event on one thread: a span of time, or an instant if begin and end are
+     * the same, with up to four values.
+     */
+    struct TraceRecord {
+        /** When the event began and ended on traceClock(). */
+        uint64_t begin;
+        uint64_t end;
+        /** What happened, a string literal that names the event in the trace. */
+        const char* name;
+        /** Names of values, a static array of string literals, null for values unused. Null if there are none. */
+        const char* const* valueNames;
+        uint32_t values[4];
+        /** The tile the event is about, if any. */
+        uint16_t x;
+        uint16_t y;
+    };
+
+    namespace detail {
+        extern std::atomic<bool> tracingOn;
+    }
+
+    /** Start or stop recording. Records already made are kept. */
+    void setTracing(bool on);
+
+    /** Whether trace calls record anything. */
+    inline bool tracing()
+    {
+        return detail::tracingOn.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * A small number for the calling thread, handed out in the order threads first
+     * ask for one. Traces name threads by these.
+     */
+    unsigned threadNumber();
+
+    /** Nanoseconds on the clock trace records are timed by. */
+    uint64_t traceClock();
+
+    /**
+     * Append a record to the calling thread's ring, overwriting its oldest once
+     * the ring is full. Only a thread's first record takes a lock, to register
+     * its ring.
+     */
+    void recordTrace(const TraceRecord& record);
+
+    /** The start of a span to pass to traceSpan(), or 0 if tracing is off. */
+    inline uint64_t traceBegin()
+    {
+        return tracing() ? traceClock() : 0;
+    }
+
+    /** Record a span from begin, from traceBegin(), to now. */
+    inline void traceSpan(const char* const name, const uint64_t begin, const uint16_t x = 0, const uint16_t y = 0,
+                          const char* const* const valueNames = nullptr,
+                          const uint32_t value0 = 0, const uint32_t value1 = 0, const uint32_t value2 = 0, const uint32_t value3 = 0)
+    {
+        if(tracing())
+        {
+            const uint64_t end = traceClock();
+            // A span begun before tracing was turned on has no start, so is shown as an instant:
+            recordTrace({begin > 0 ? begin : end, end, name, valueNames, {value0, value1, value2, value3}, x, y});
+        }
+    }
+
+    /** Record an instant. */
+    inline void traceInstant(const char* const name, const uint16_t x = 0, const uint16_t y = 0,
+                             const char* const* const valueNames = nullptr, const uint32_t value0 = 0)
+    {
+        if(tracing())
+        {
+            const uint64_t now = traceClock();
+            recordTrace({now, now, name, valueNames, {value0, 0, 0, 0}, x, y});
+        }
+    }
+
+    /**
+     * Write every thread's records to path as Chrome trace event JSON. The
+     * threads should be done recording, or records being overwritten as they
+     * are read may come out garbled.
+     * @return The number of records written, or -1 if the file couldn't be written.
+     */
+    long writeChromeTrace(const char* path);
+
+} // async_tiled
+
+#endif // STLAB_EXPERIMENTS_MANDELBROT_TRACE_H